@@ -0,0 +1,204 @@
+/**
+ * \file
+ * Copies one file series to another, regrouping planes between member files.
+ *
+ * \verbatim
+   ndio-series-convert [-g planes] [-m MB] [-t threads] <source> <destination>
+   \endverbatim
+ *
+ * For example, to turn a series of 2D planes into stacks of 64 planes, and
+ * back:
+ *
+ * \verbatim
+   ndio-series-convert -g 64 vol.%.tif stack.%.tif
+   ndio-series-convert -g 1  stack.%.tif vol.%.tif
+   \endverbatim
+ *
+ * A plane is the first two dimensions of a member file.  With \c -g the
+ * planes, in order, are regrouped \a planes to a destination member, and
+ * the destination has one file name field.  The last member may be short;
+ * reading the destination as a series pads it with zeros.  Without it the
+ * members keep their shape, so only the format changes (as given by the
+ * destination's extension).
+ *
+ * The whole volume is never held in memory.  The source is read in slabs
+ * along its last file name field on a background thread, several member
+ * files at once (see ndioSeriesSlabBegin()).  Since the planes in a slab are
+ * already in order, regrouping is only a reshape.  Each slab is queued on the
+ * destination's background writer, which encodes several members at once
+ * (see ndio_series_params_t::async).  So reading, regrouping and encoding
+ * overlap, with half of the \c -m budget for slabs and half for the write
+ * queue.
+ *
+ * The destination is opened for appending, so its members are numbered on
+ * from any that already exist.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nd.h"
+#include "src/ndio-series.h"
+
+/// @cond DEFINES
+#define ENDL                  "\n"
+#define LOG(...)              fprintf(stderr,__VA_ARGS__)
+#define TRY(e)                do{if(!(e)) { LOG("%s(%d): %s()"ENDL "\tExpression evaluated as false."ENDL "\t%s"ENDL,__FILE__,__LINE__,__FUNCTION__,#e); goto Error;}} while(0)
+#define TRYMSG(e,msg)         do{if(!(e)) {LOG("%s(%d): %s()"ENDL "\tExpression evaluated as false."ENDL "\t%s"ENDL "\t%s"ENDL,__FILE__,__LINE__,__FUNCTION__,#e,msg); goto Error; }}while(0)
+/// @endcond
+
+/** Command line options. */
+struct options_t
+{ const char *src,*dst;
+  size_t      group;   ///< planes per destination member, or 0 to keep the source's members
+  size_t      budget;  ///< bytes
+  unsigned    threads; ///< member files at once, or 0 to tune
+};
+
+static void usage(const char *name)
+{ LOG("Usage: %s [-g planes] [-m MB] [-t threads] <source> <destination>"ENDL
+      "\t-g planes  Planes per destination member file.  Default: as the source."ENDL
+      "\t-m MB      Memory to use.  Default: 1024."ENDL
+      "\t-t threads Member files to read or write at once.  Default: tuned."ENDL,name);
+}
+
+/** \returns true if the command line is valid, otherwise false. */
+static bool parse(int argc, char *argv[], options_t *opt)
+{ int i,n=0;
+  opt->src=opt->dst=0;
+  opt->group=0;
+  opt->budget=1024ULL<<20;
+  opt->threads=0;
+  for(i=1;i<argc;++i)
+  { if(argv[i][0]=='-' && argv[i][1] && !argv[i][2])
+    { char *end=0;
+      unsigned long long v;
+      if(i+1>=argc) return false;
+      v=strtoull(argv[++i],&end,10);
+      if(!end || *end) return false;
+      switch(argv[i-1][1])
+      { case 'g': if(!v) return false; opt->group=(size_t)v; break;
+        case 'm': if(!v) return false; opt->budget=(size_t)(v<<20); break;
+        case 't': opt->threads=(unsigned)v; break;
+        default:  return false;
+      }
+    } else switch(n++)
+    { case 0:  opt->src=argv[i]; break;
+      case 1:  opt->dst=argv[i]; break;
+      default: return false;
+    }
+  }
+  return n==2;
+}
+
+static size_t gcd(size_t a, size_t b)
+{ while(b)
+  { size_t t=a%b;
+    a=b;
+    b=t;
+  }
+  return a;
+}
+
+/**
+ * Queues the \a type array of shape \a shape at \a data for writing to \a dst.
+ * \returns true on success, otherwise false.
+ */
+static bool put(ndio_t dst, nd_type_id_t type, char *data, unsigned ndim, const size_t *shape)
+{ nd_t v=0;
+  TRY(v=ndinit());
+  TRY(ndreshape(ndcast(v,type),ndim,shape));
+  TRY(ndref(v,data,nd_static));
+  TRY(ndioWrite(dst,v));
+  ndfree(v);
+  return true;
+Error:
+  ndfree(v);
+  return false;
+}
+
+/**
+ * Queues the planes of \a slab for writing to \a dst, \a group planes to a
+ * member.  A plane is the first \a np dimensions of \a slab and is \a nbytes
+ * bytes.
+ * \returns true on success, otherwise false.
+ */
+static bool regroup(ndio_t dst, nd_t slab, unsigned np, size_t nbytes, size_t group)
+{ size_t shape[4];
+  const size_t nplanes=ndnbytes(slab)/nbytes,whole=nplanes/group,rest=nplanes%group;
+  unsigned n=np;
+  memcpy(shape,ndshape(slab),np*sizeof(size_t));
+  if(group>1)
+    shape[n++]=group;
+  shape[n++]=whole;
+  if(whole)
+    TRY(put(dst,ndtype(slab),(char*)nddata(slab),n,shape));
+  if(rest)                           // the last, short member
+  { shape[np]=rest;
+    shape[np+1]=1;
+    TRY(put(dst,ndtype(slab),(char*)nddata(slab)+whole*group*nbytes,np+2,shape));
+  }
+  return true;
+Error:
+  return false;
+}
+
+int main(int argc, char *argv[])
+{ options_t opt;
+  ndio_t src=0,dst=0;
+  nd_t vol=0,slab;
+  ndio_series_params_t p;
+  size_t *slabshape=0,*origin=0,per=1,plane=0,step=1,k,done=0;
+  unsigned nf,nd,np;
+  int ecode=1;
+  if(!parse(argc,argv,&opt))
+  { usage(argv[0]);
+    return 2;
+  }
+  TRYMSG(src=ndioOpen(opt.src,ndioFormat("series"),"r"),opt.src);
+  TRYMSG(vol=ndioShape(src),opt.src);
+  TRYMSG(nf=ndioSeriesFieldCount(src),"The source isn't a file series.");
+  nd=ndndim(vol);
+  np=(nd-nf<2)?(nd-nf):2;
+  plane=ndbpp(vol);
+  for(unsigned i=0;i<np;++i)
+    plane*=ndshape(vol)[i];
+  for(unsigned i=np;i<nd-1;++i)      // planes per position along the last field
+    per*=ndshape(vol)[i];
+  if(opt.group)                      // slabs hold whole destination members
+    step=opt.group/gcd(per,opt.group);
+  k=(opt.budget/4)/(per*plane);      // a slab: a quarter of the budget
+  k=(k<step)?step:(k/step*step);
+  // Read
+  p=((ndio_series_t*)ndioGet(src))->params;
+  p.threads=opt.threads;
+  TRY(ndioSet(src,&p,sizeof(p)));
+  TRY(slabshape=(size_t*)calloc(nf,sizeof(size_t)));
+  TRY(origin=(size_t*)calloc(nd,sizeof(size_t)));
+  slabshape[nf-1]=k;
+  TRYMSG(ndioSeriesSlabBegin(src,slabshape,2*k*per*plane),opt.src);
+  // Write
+  TRYMSG(dst=ndioOpen(opt.dst,ndioFormat("series"),"a"),opt.dst);
+  p=((ndio_series_t*)ndioGet(dst))->params;
+  p.threads=opt.threads;
+  p.async=1;
+  p.queue_budget=opt.budget/2;
+  TRY(ndioSet(dst,&p,sizeof(p)));
+  while(ndioSeriesSlabNext(src,&slab,origin))
+  { if(opt.group)
+      TRYMSG(regroup(dst,slab,np,plane,opt.group),opt.dst);
+    else
+      TRYMSG(ndioWrite(dst,slab),opt.dst);
+    done+=ndshape(slab)[nd-1];
+  }
+  TRYMSG(done==ndshape(vol)[nd-1],"Could not read the source.");
+  TRYMSG(ndioSeriesFlush(dst),opt.dst);
+  ecode=0;
+Error:
+  if(src) ndioSeriesSlabEnd(src);
+  ndioClose(dst);
+  ndioClose(src);
+  ndfree(vol);
+  free(slabshape);
+  free(origin);
+  return ecode;
+}
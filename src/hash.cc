@@ -0,0 +1,249 @@
+/**
+ * \file
+ * Fast content hashing for member files.
+ *
+ * hash64() is XXH64 (Yann Collet's xxHash, BSD license), which runs at
+ * several GB/s so hashing a slab costs much less than encoding it.
+ *
+ * crc32c() uses the CPU's CRC-32C instruction where there is one, checked
+ * at run time on x86, and slicing-by-8 tables otherwise.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "hash.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HAVE_CRC32C_SSE42
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSE42
+#else
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#elif defined(__ARM_FEATURE_CRC32)
+#define HAVE_CRC32C_ARM
+#include <arm_acle.h>
+#endif
+
+/// @cond DEFINES
+#define P1 11400714785074694791ULL
+#define P2 14029467366897019727ULL
+#define P3  1609587929392839161ULL
+#define P4  9650029242287828579ULL
+#define P5  2870177450012600261ULL
+/// @endcond
+
+static uint64_t rotl(uint64_t x,int r) { return (x<<r)|(x>>(64-r)); }
+static uint64_t read64(const unsigned char *p) { uint64_t v; memcpy(&v,p,8); return v; }
+static uint32_t read32(const unsigned char *p) { uint32_t v; memcpy(&v,p,4); return v; }
+
+static uint64_t round_(uint64_t acc,uint64_t v)
+{ acc+=v*P2;
+  acc=rotl(acc,31);
+  return acc*P1;
+}
+
+static uint64_t merge_(uint64_t acc,uint64_t v)
+{ acc^=round_(0,v);
+  return acc*P1+P4;
+}
+
+/** Consume whole 32 byte stripes. \returns the number of bytes consumed. */
+static size_t stripes_(uint64_t *v,const unsigned char *p,size_t nbytes)
+{ const unsigned char *e=p+(nbytes&~(size_t)31),*b=p;
+  for(;p<e;p+=32)
+  { v[0]=round_(v[0],read64(p));
+    v[1]=round_(v[1],read64(p+8));
+    v[2]=round_(v[2],read64(p+16));
+    v[3]=round_(v[3],read64(p+24));
+  }
+  return p-b;
+}
+
+void hash_init(hash_state_t *s, uint64_t seed)
+{ memset(s,0,sizeof(*s));
+  s->seed=seed;
+  s->v[0]=seed+P1+P2;
+  s->v[1]=seed+P2;
+  s->v[2]=seed;
+  s->v[3]=seed-P1;
+}
+
+void hash_update(hash_state_t *s, const void *data, size_t nbytes)
+{ const unsigned char *p=(const unsigned char*)data;
+  s->total+=nbytes;
+  if(s->nbuf)
+  { size_t n=32-s->nbuf;
+    n=(n<nbytes)?n:nbytes;
+    memcpy(s->buf+s->nbuf,p,n);
+    s->nbuf+=(unsigned)n;
+    p+=n; nbytes-=n;
+    if(s->nbuf<32) return;
+    stripes_(s->v,s->buf,32);
+    s->nbuf=0;
+  }
+  { size_t n=stripes_(s->v,p,nbytes);
+    p+=n; nbytes-=n;
+  }
+  memcpy(s->buf,p,nbytes);
+  s->nbuf=(unsigned)nbytes;
+}
+
+uint64_t hash_final(const hash_state_t *s)
+{ const unsigned char *p=s->buf,*e=p+s->nbuf;
+  uint64_t h;
+  if(s->total>=32)
+  { h=rotl(s->v[0],1)+rotl(s->v[1],7)+rotl(s->v[2],12)+rotl(s->v[3],18);
+    h=merge_(h,s->v[0]);
+    h=merge_(h,s->v[1]);
+    h=merge_(h,s->v[2]);
+    h=merge_(h,s->v[3]);
+  } else
+    h=s->seed+P5;
+  h+=s->total;
+  for(;p+8<=e;p+=8)
+    h=rotl(h^round_(0,read64(p)),27)*P1+P4;
+  if(p+4<=e)
+  { h=rotl(h^((uint64_t)read32(p)*P1),23)*P2+P3;
+    p+=4;
+  }
+  for(;p<e;++p)
+    h=rotl(h^((*p)*P5),11)*P1;
+  h^=h>>33; h*=P2;
+  h^=h>>29; h*=P3;
+  h^=h>>32;
+  return h;
+}
+
+uint64_t hash64(const void *data, size_t nbytes, uint64_t seed)
+{ hash_state_t s;
+  hash_init(&s,seed);
+  hash_update(&s,data,nbytes);
+  return hash_final(&s);
+}
+
+/** Feed rows along dimension 0, recursing over the outer dimensions. */
+static void hash_rows(hash_state_t *s,const char *d,const size_t *shape,const size_t *strides,int idim,size_t bpp)
+{ if(idim==0)
+  { if(strides[0]==bpp)
+      hash_update(s,d,shape[0]*bpp);
+    else
+      for(size_t i=0;i<shape[0];++i)
+        hash_update(s,d+i*strides[0],bpp);
+    return;
+  }
+  for(size_t i=0;i<shape[idim];++i)
+    hash_rows(s,d+i*strides[idim],shape,strides,idim-1,bpp);
+}
+
+uint64_t hash_nd(const nd_t a)
+{ const unsigned n=ndndim(a);
+  const size_t *shape=ndshape(a),
+               *strides=ndstrides(a);
+  hash_state_t s;
+  hash_init(&s,(uint64_t)ndtype(a));
+  hash_update(&s,shape,n*sizeof(size_t));
+  if(n)
+    hash_rows(&s,(const char*)nddata(a),shape,strides,(int)n-1,ndbpp(a));
+  return hash_final(&s);
+}
+
+//
+// === CRC-32C ===
+//
+
+/** Slicing-by-8 tables for the reflected Castagnoli polynomial. */
+struct crc_tables_t
+{ uint32_t t[8][256];
+  crc_tables_t()
+  { for(uint32_t i=0;i<256;++i)
+    { uint32_t c=i;
+      for(int k=0;k<8;++k)
+        c=(c>>1)^(0x82F63B78u&(0u-(c&1)));
+      t[0][i]=c;
+    }
+    for(uint32_t i=0;i<256;++i)
+      for(int k=1;k<8;++k)
+        t[k][i]=(t[k-1][i]>>8)^t[0][t[k-1][i]&0xff];
+  }
+};
+
+static uint32_t crc32c_sw(uint32_t c,const unsigned char *p,size_t n)
+{ static const crc_tables_t T;
+  const uint32_t (*t)[256]=T.t;
+  for(;n>=8;n-=8,p+=8)
+  { uint64_t v=read64(p)^c;
+    c=t[7][ v     &0xff]^t[6][(v>> 8)&0xff]^t[5][(v>>16)&0xff]^t[4][(v>>24)&0xff]
+     ^t[3][(v>>32)&0xff]^t[2][(v>>40)&0xff]^t[1][(v>>48)&0xff]^t[0][ v>>56      ];
+  }
+  while(n--)
+    c=(c>>8)^t[0][(c^*p++)&0xff];
+  return c;
+}
+
+#if defined(HAVE_CRC32C_SSE42)
+TARGET_SSE42 static uint32_t crc32c_hw(uint32_t c,const unsigned char *p,size_t n)
+{ uint64_t c64=c;
+  for(;n>=8;n-=8,p+=8)
+    c64=_mm_crc32_u64(c64,read64(p));
+  c=(uint32_t)c64;
+  while(n--)
+    c=_mm_crc32_u8(c,*p++);
+  return c;
+}
+
+static bool has_crc32c_hw()
+{
+#ifdef _MSC_VER
+  int r[4];
+  __cpuid(r,1);
+  return (r[2]>>20)&1;
+#else
+  return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#elif defined(HAVE_CRC32C_ARM)
+static uint32_t crc32c_hw(uint32_t c,const unsigned char *p,size_t n)
+{ for(;n>=8;n-=8,p+=8)
+    c=__crc32cd(c,read64(p));
+  while(n--)
+    c=__crc32cb(c,*p++);
+  return c;
+}
+
+static bool has_crc32c_hw() { return true; }
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t nbytes)
+{
+#if defined(HAVE_CRC32C_SSE42) || defined(HAVE_CRC32C_ARM)
+  static const bool hw=has_crc32c_hw();
+  if(hw)
+    return ~crc32c_hw(~crc,(const unsigned char*)data,nbytes);
+#endif
+  return crc32c_tables(crc,data,nbytes);
+}
+
+uint32_t crc32c_tables(uint32_t crc, const void *data, size_t nbytes)
+{ return ~crc32c_sw(~crc,(const unsigned char*)data,nbytes);
+}
+
+bool crc32c_file(const char *path, uint32_t *crc)
+{ static const size_t N=1<<20;
+  FILE *fp=fopen(path,"rb");
+  unsigned char *buf=0;
+  uint32_t c=0;
+  size_t n;
+  bool ok=false;
+  if(!fp) return false;
+  if((buf=new unsigned char[N]))
+  { while((n=fread(buf,1,N,fp))>0)
+      c=crc32c(c,buf,n);
+    ok=!ferror(fp);
+  }
+  delete [] buf;
+  fclose(fp);
+  if(ok) *crc=c;
+  return ok;
+}
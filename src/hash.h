@@ -0,0 +1,49 @@
+/**
+ * \file
+ * Fast content hashing and checksums for member files.
+ */
+#ifndef H_NDIO_SERIES_HASH
+#define H_NDIO_SERIES_HASH
+
+#include <stddef.h>
+#include "nd.h"
+
+/** Streaming state for hash64(). */
+struct hash_state_t
+{ uint64_t      v[4],seed,total;
+  unsigned char buf[32];
+  unsigned      nbuf;
+};
+
+void     hash_init  (hash_state_t *s, uint64_t seed);
+void     hash_update(hash_state_t *s, const void *data, size_t nbytes);
+uint64_t hash_final (const hash_state_t *s);
+
+/**
+ * 64-bit hash of \a nbytes bytes at \a data (XXH64).
+ * Same result as feeding the bytes through hash_update() in any number of
+ * pieces.
+ */
+uint64_t hash64(const void *data, size_t nbytes, uint64_t seed);
+
+/**
+ * Hash the contents, shape and type of the array \a a.
+ * Strided arrays are hashed row by row, so the result only depends on the
+ * values, not the layout in memory.
+ */
+uint64_t hash_nd(const nd_t a);
+
+/**
+ * CRC-32C (Castagnoli) of \a nbytes bytes at \a data, continuing from \a crc,
+ * which is 0 to start.  Uses the SSE 4.2 or ARMv8 CRC instructions when the
+ * CPU has them.
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t nbytes);
+
+/** crc32c() without the CPU instructions, as on CPUs that don't have them. */
+uint32_t crc32c_tables(uint32_t crc, const void *data, size_t nbytes);
+
+/** Sets \a crc to the CRC-32C of the file \a path.  \returns true on success, otherwise false. */
+bool crc32c_file(const char *path, uint32_t *crc);
+
+#endif //H_NDIO_SERIES_HASH
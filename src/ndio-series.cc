@@ -27,8 +27,6 @@
  * \todo Allow elements of the path to enumerate a dimension, as opposed to
  *       the filename alone.
  *
- * \todo Seek needs to know field width of filenames. How?
- *       Another option is to maintain a table mapping from positions to filenames
  * \author Nathan Clack
  * \date   Aug 2012
  */
@@ -37,19 +35,57 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
+#include <set>
+#include <list>
+#include <memory>
+#include <algorithm>
 #include <tre/tre.h>
 #include <cerrno>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <future>
 #include "nd.h"
+#include "ndio-series.h"
+#include "xfer.h"
+#include "hash.h"
+#include "pack.h"
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #define AUTODETECT // turn on filename based detection of file series
 
 #ifdef _MSC_VER
 #include "dirent.win.h"
 #pragma warning(disable:4996) // security warning
+#include <process.h>
 #define snprintf _snprintf
+#define getpid   _getpid
 #else
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#define HAVE_INOTIFY
+#include <sys/inotify.h>
+#include <poll.h>
+#include <time.h>
+#define HAVE_USERFAULTFD
+#include <linux/userfaultfd.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#ifndef UFFD_USER_MODE_ONLY
+#define UFFD_USER_MODE_ONLY 1
+#endif
 #endif
 
 /// @cond DEFINES
@@ -81,13 +117,14 @@ typedef std::vector<size_t> TPos;
  * Set read/write mode flags according to mode string.
  */
 static
-bool parse_mode_string(const char* mode, char *isr, char *isw)
+bool parse_mode_string(const char* mode, char *isr, char *isw, char *isa)
 { const char *c=mode;
-  *isr=*isw=0;
+  *isr=*isw=*isa=0;
   do
   { switch(*c)
     { case 'r': *isr=1; break;
       case 'w': *isw=1; break;
+      case 'a': *isw=*isa=1; break;
       default:  FAIL("Invalid mode string");
     }
   } while(*++c);
@@ -133,7 +170,8 @@ static void vadd(std::vector<size_t> &acc, TPos& pos)
 /** Assemble full path to an ndio_t file and open it. */
 static ndio_t openfile(const std::string& path, const char* fname)
 { std::string name(path);
-  name.append(PATHSEP);
+  if(!path.empty())
+    name.append(PATHSEP);
   name.append(fname);
   return ndioOpen(name.c_str(),NULL,"r");
 }
@@ -152,45 +190,618 @@ Error:
 }
 
 /**
-Replace - returns number of replacements
-*/
-static int replace(std::string *str, const regex_t& pattern, const char* rewrite) {
-  regmatch_t match={0};
-  std::string out("");
-  const char *s=str->c_str();
-  const std::string r(rewrite);
-  int n=0;
-  while(tre_regexec(&pattern,s,1,&match,0)==0) {    
-    out+=std::string(s,match.rm_so)+r;
-    s+=match.rm_eo;
-    ++n;
-  }
-  out+=std::string(s); // add any remainder
-  if(n)
-    *str=out;
-  return n;
+ * A reusable buffer for decoding one member file.
+ * Each thread that decodes member files needs its own.
+ */
+struct scratch_t
+{ nd_t   a;
+  char  *buf;
+  size_t nbytes;
+  xfer_stats_t *stats; ///< (stats mode) counts the values of the member being read, or NULL
+
+  scratch_t():a(0),buf(0),nbytes(0),stats(0) {}
+  ~scratch_t() { ndfree(a); SAFEFREE(buf); }
+
+  /**
+   * Shape the buffer as an array of type \a type and shape \a shape, growing
+   * the allocation if necessary.
+   * \returns the array on success, otherwise NULL.
+   */
+  nd_t reshape(nd_type_id_t type, unsigned ndim, const size_t *shape)
+  { if(!a)
+      TRY(a=ndinit());
+    TRY(ndreshape(ndcast(a,type),ndim,shape));
+    if(nbytes<ndnbytes(a))
+    { RESIZE(char,buf,ndnbytes(a));
+      nbytes=ndnbytes(a);
+    }
+    return ndref(a,buf,nd_static);
+  Error:
+    return 0;
+  }
+private:
+  scratch_t(const scratch_t&);
+  scratch_t& operator=(const scratch_t&);
+};
+
+/**
+ * Describes the part of \a a at file name position \a ipos.
+ *
+ * The dimensions of \a a listed in \a fd are held at \a ipos.  The remaining
+ * dimensions, in order, give \a shape and \a strides, which must have room
+ * for ndndim(a) elements.
+ *
+ * \returns the address of the part's first element.
+ */
+static char* member_view(nd_t a,const std::vector<unsigned>& fd,const size_t *ipos,
+                         size_t *shape,size_t *strides,unsigned *ndim)
+{ char *p=(char*)nddata(a);
+  unsigned i,k,n=0;
+  for(i=0;i<ndndim(a);++i)
+  { for(k=0;k<fd.size() && fd[k]!=i;++k) {}
+    if(k<fd.size())
+      p+=ipos[k]*ndstrides(a)[i];
+    else
+    { shape[n]=ndshape(a)[i];
+      strides[n++]=ndstrides(a)[i];
+    }
+  }
+  *ndim=n;
+  return p;
+}
+
+/**
+ * Durable, crash-consistent replacement of a batch of files.
+ *
+ * Files are written under a temporary name and handed to add(), which
+ * starts writeback without waiting for it.  Every \a batch files, commit()
+ * waits for the data, renames all the files into place and syncs the
+ * directory once.  Readers either see the old file or the complete new one,
+ * and the cost of the syncs is shared across the batch instead of stalling
+ * on every file.
+ */
+struct commit_t
+{ struct pending_t
+  { std::string tmp,name;
+    int fd;
+  };
+  size_t                batch_;
+  std::vector<pending_t> pending_;
+
+  commit_t(size_t batch)
+  : batch_(batch?batch:1) {}
+  ~commit_t() { abort(); }
+
+  /** \returns the temporary name to write \a name under. */
+  static std::string tmpname(const std::string& name)
+  { size_t n=name.rfind(PATHSEP[0]);
+    n=(n==std::string::npos)?0:n+1;
+    return name.substr(0,n)+".~"+name.substr(n); // keep the extension for format detection
+  }
+
+  /** \returns the directory holding the file \a name. */
+  static std::string dirname(const std::string& name)
+  { size_t n=name.rfind(PATHSEP[0]);
+    return (n==std::string::npos)?".":name.substr(0,n?n:1);
+  }
+
+  /**
+   * Queues the written file \a tmp to be renamed to \a name.
+   * \returns true on success, otherwise false.
+   */
+  bool add(const std::string& tmp, const std::string& name)
+  { pending_t p;
+    p.tmp=tmp;
+    p.name=name;
+    p.fd=-1;
+#ifndef _MSC_VER
+    TRYMSG((p.fd=open(tmp.c_str(),O_RDONLY))>=0,strerror(errno));
+#ifdef __linux__
+    sync_file_range(p.fd,0,0,SYNC_FILE_RANGE_WRITE); // start writeback, don't wait
+#endif
+#endif
+    pending_.push_back(p);
+    if(pending_.size()>=batch_)
+      return commit();
+    return true;
+Error:
+    LOG("\t%s"ENDL,tmp.c_str());
+    remove(tmp.c_str());
+    return false;
+  }
+
+  /**
+   * Waits for the queued files' data, renames them into place and syncs
+   * the directory.
+   * \returns true on success, otherwise false.
+   */
+  bool commit()
+  { std::set<std::string> dirs;
+    std::set<std::string>::const_iterator d=dirs.end();
+    size_t i;
+    if(pending_.empty()) return true;
+#ifndef _MSC_VER
+    for(i=0;i<pending_.size();++i)
+    { // Most of the data is already on its way from add(), so this is cheap.
+      // fdatasync() rather than sync_file_range() because the new file's
+      // size and block allocation have to be durable too.
+#ifdef __linux__
+      TRYMSG(fdatasync(pending_[i].fd)==0,strerror(errno));
+#else
+      TRYMSG(fsync(pending_[i].fd)==0,strerror(errno));
+#endif
+      close(pending_[i].fd);
+      pending_[i].fd=-1;
+    }
+#endif
+    for(i=0;i<pending_.size();++i)
+    {
+#ifdef _MSC_VER
+      remove(pending_[i].name.c_str()); // rename() won't replace an existing file
+#endif
+      TRYMSG(rename(pending_[i].tmp.c_str(),pending_[i].name.c_str())==0,strerror(errno));
+      pending_[i].tmp.clear();
+      dirs.insert(dirname(pending_[i].name));
+    }
+#ifndef _MSC_VER
+    for(d=dirs.begin();d!=dirs.end();++d) // one sync per directory, e.g. per stripe
+    { int fd;
+      TRYMSG((fd=open(d->c_str(),O_RDONLY))>=0,strerror(errno));
+      i=fsync(fd);
+      close(fd);
+      TRYMSG(i==0,strerror(errno));
+    }
+#endif
+    pending_.clear();
+    return true;
+Error:
+    if(d!=dirs.end())
+      LOG("\t%s"ENDL,d->c_str());
+    abort();
+    return false;
+  }
+
+  /** Drops queued files that haven't been renamed into place. */
+  void abort()
+  { for(size_t i=0;i<pending_.size();++i)
+    {
+#ifndef _MSC_VER
+      if(pending_[i].fd>=0) close(pending_[i].fd);
+#endif
+      if(!pending_[i].tmp.empty()) remove(pending_[i].tmp.c_str());
+    }
+    pending_.clear();
+  }
+};
+
+//
+// === SHARED LISTINGS ===
+//
+
+/**
+ * What listing a series' directory found: the member files by position and
+ * their extents.
+ *
+ * Listings are shared by every handle open on the same series, through
+ * listings(), so opening a series that's already known doesn't list the
+ * directory again.  The table and extents don't change once published.
+ */
+struct listing_t
+{ std::map<TPos,std::string> table;
+  TPos                       mn,mx;
+  time_t                     mtime;   ///< the directory's mtime when it was listed
+  bool                       racy;    ///< listed too soon after mtime to trust it
+  uint64_t                   tick;    ///< when it was last used, for eviction
+
+  listing_t(): mtime(0),racy(true),tick(0),ftype_(nd_id_unknown),fmtime_(0),fsize_(0),fracy_(true) {}
+
+  /** \returns the shape of the first member, or NULL on error.  Remembered while the file is unchanged. */
+  nd_t shape(const std::string& path)
+  { std::lock_guard<std::mutex> g(lock_);
+    std::string name(path);
+    struct stat st;
+    nd_t out=0;
+    if(table.empty()) return 0;
+    if(!path.empty())
+      name.append(PATHSEP);
+    name.append(table.begin()->second);
+    if(stat(name.c_str(),&st)!=0) return 0;
+    if(!fshape_.empty() && !fracy_ && st.st_mtime==fmtime_ && (uint64_t)st.st_size==fsize_)
+    { TRY(out=ndinit());
+      return ndreshape(ndcast(out,ftype_),(unsigned)fshape_.size(),&fshape_[0]);
+    }
+    if((out=get_file_shape(path,table.begin()->second.c_str())))
+    { fshape_.assign(ndshape(out),ndshape(out)+ndndim(out));
+      ftype_=ndtype(out);
+      fmtime_=st.st_mtime;
+      fsize_=(uint64_t)st.st_size;
+      fracy_=time(NULL)<=fmtime_+1;
+    }
+    return out;
+Error:
+    return 0;
+  }
+
+private:
+  std::mutex          lock_;
+  std::vector<size_t> fshape_;        ///< shape of the first member, once known
+  nd_type_id_t        ftype_;
+  time_t              fmtime_;
+  uint64_t            fsize_;
+  bool                fracy_;
+};
+typedef std::shared_ptr<listing_t> TListing;
+
+/**
+ * Process-wide cache of listings, keyed by the canonical directory and the
+ * file name pattern.
+ *
+ * A listing is reused while the directory's mtime is unchanged.  Creating,
+ * removing or renaming a file updates it.  A listing made within a second
+ * of that mtime could have missed a change in the same second, so it's
+ * never reused (as with git's "racy" index entries).
+ *
+ * Handles keep the listings they use alive.  The cache holds at most
+ * \c capacity listings, dropping the least recently used ones no handle is
+ * using.
+ */
+class listing_cache_t
+{ public:
+  enum { capacity=64 };
+
+  listing_cache_t(): tick_(0) {}
+
+  /** \returns the listing for \a key if it's still good for a directory with stat \a st, otherwise NULL. */
+  TListing get(const std::string& key, const struct stat& st)
+  { std::lock_guard<std::mutex> g(lock_);
+    std::map<std::string,TListing>::iterator it=cache_.find(key);
+    if(it==cache_.end() || it->second->racy || it->second->mtime!=st.st_mtime)
+      return TListing();
+    it->second->tick=++tick_;
+    return it->second;
+  }
+
+  /** Publishes \a listing for \a key, replacing any older one. */
+  void put(const std::string& key, const TListing& listing)
+  { std::lock_guard<std::mutex> g(lock_);
+    listing->tick=++tick_;
+    cache_[key]=listing;
+    while(cache_.size()>capacity)
+    { std::map<std::string,TListing>::iterator it,lru=cache_.end();
+      for(it=cache_.begin();it!=cache_.end();++it)
+        if(it->second.use_count()==1 && (lru==cache_.end() || it->second->tick<lru->second->tick))
+          lru=it;
+      if(lru==cache_.end()) break;   // all in use
+      cache_.erase(lru);
+    }
+  }
+
+  private:
+  std::mutex                     lock_;
+  std::map<std::string,TListing> cache_;
+  uint64_t                       tick_;
+};
+
+static listing_cache_t& listings()
+{ static listing_cache_t cache;
+  return cache;
+}
+
+/** \returns \a dir with links and relative parts resolved, or \a dir as is if that fails. */
+static std::string canonical(const std::string& dir)
+{
+#ifdef _MSC_VER
+  return dir;                    // already a full path, see series_t()
+#else
+  char *p=realpath(dir.c_str(),NULL);
+  std::string out(p?p:dir.c_str());
+  free(p);
+  return out;
+#endif
+}
+
+/**
+ * A decoded member file, shared through the tile cache.  Holds the pixels
+ * in the file's own type.
+ */
+struct tile_t
+{ nd_t     a;
+  time_t   mtime;   ///< the file's mtime when it was decoded
+  uint64_t size;    ///< the file's size when it was decoded
+  bool     racy;    ///< decoded too soon after mtime to trust it.  See listing_cache_t.
+
+  tile_t(): a(0),mtime(0),size(0),racy(true) {}
+  ~tile_t() { ndfree(a); }
+private:
+  tile_t(const tile_t&);
+  tile_t& operator=(const tile_t&);
+};
+typedef std::shared_ptr<tile_t> TTile;
+
+/**
+ * Process-wide cache of decoded member files, keyed by the member's
+ * canonical path, with least recently used eviction.  See
+ * ndioSeriesCacheBudget().
+ *
+ * A tile is reused while its file's mtime and size are unchanged.  Tiles
+ * handed out stay valid after they're evicted, until they're released.
+ */
+class tile_cache_t
+{ public:
+  tile_cache_t(): budget_(0),bytes_(0),hits_(0),misses_(0),evictions_(0) {}
+
+  size_t budget()
+  { std::lock_guard<std::mutex> g(lock_);
+    return budget_;
+  }
+
+  void set_budget(size_t budget)
+  { std::lock_guard<std::mutex> g(lock_);
+    budget_=budget;
+    shrink_();
+  }
+
+  /** \returns the tile for \a key if it's still good for a file with stat \a st, otherwise NULL. */
+  TTile get(const std::string& key, const struct stat& st)
+  { std::lock_guard<std::mutex> g(lock_);
+    TIndex::iterator it=index_.find(key);
+    if(it!=index_.end())
+    { const TTile& t=it->second->second;
+      if(t->mtime==st.st_mtime && t->size==(uint64_t)st.st_size)
+      { lru_.splice(lru_.begin(),lru_,it->second);
+        ++hits_;
+        return t;
+      }
+      erase_(it);                 // stale
+    }
+    ++misses_;
+    return TTile();
+  }
+
+  /** Adds \a t as \a key, evicting the least recently used tiles to stay in budget. */
+  void put(const std::string& key, const TTile& t)
+  { std::lock_guard<std::mutex> g(lock_);
+    TIndex::iterator it;
+    const size_t n=ndnbytes(t->a);
+    if(t->racy || n>budget_) return;
+    if((it=index_.find(key))!=index_.end())
+      erase_(it);
+    lru_.push_front(std::make_pair(key,t));
+    index_[key]=lru_.begin();
+    bytes_+=n;
+    shrink_();
+  }
+
+  void stats(ndio_series_cache_stats_t *s)
+  { std::lock_guard<std::mutex> g(lock_);
+    s->hits=hits_;
+    s->misses=misses_;
+    s->evictions=evictions_;
+    s->bytes=bytes_;
+    s->budget=budget_;
+    s->ntiles=index_.size();
+  }
+
+  private:
+  typedef std::list<std::pair<std::string,TTile> > TList;  // most recently used first
+  typedef std::map<std::string,TList::iterator>   TIndex;
+  std::mutex lock_;
+  TList      lru_;
+  TIndex     index_;
+  size_t     budget_,bytes_;
+  uint64_t   hits_,misses_,evictions_;
+
+  void erase_(TIndex::iterator it)
+  { bytes_-=ndnbytes(it->second->second->a);
+    lru_.erase(it->second);
+    index_.erase(it);
+  }
+
+  void shrink_()
+  { while(bytes_>budget_ && !lru_.empty())
+    { erase_(index_.find(lru_.back().first));
+      ++evictions_;
+    }
+  }
+};
+
+static tile_cache_t& tiles()
+{ static tile_cache_t cache;
+  return cache;
 }
 
+//
+// === CONCURRENCY ===
+//
+
+/**
+ * Picks how many member files to read or write at once.
+ *
+ * The best number depends on where the files live: a couple for a local
+ * disk, many more for a network file system.  So the tuner measures the
+ * throughput of each window of completed files and hill climbs: the number
+ * keeps moving in one direction while throughput improves and turns around
+ * when it drops.  Time when nothing is in flight isn't counted, so windows
+ * can span calls.
+ *
+ * A fixed number (see ndio_series_params_t::threads) turns tuning off.
+ */
+struct tuner_t
+{ typedef std::chrono::steady_clock clock;
+  std::mutex              lock_;
+  std::condition_variable cv_;
+  unsigned fixed_,          ///< if non-zero, the number to use
+           max_,            ///< the most to try when tuning
+           width_,          ///< the current number, when tuning
+           busy_;           ///< files in flight
+  int      step_;           ///< +1 or -1; which way width_ moves next
+  double   rate_;           ///< bytes per second over the last window, or 0 if there wasn't one
+  size_t   bytes_,nfiles_;  ///< done in the current window
+  clock::duration   active_; ///< time in the current window with files in flight, up to since_
+  clock::time_point since_;  ///< when busy_ last went from 0 to 1
+
+  tuner_t(): fixed_(0),max_(16),width_(4),busy_(0),step_(1),rate_(0),bytes_(0),nfiles_(0),active_(0) {}
+
+  /** Sets a fixed number (0 to tune) and the most to try when tuning. */
+  void limit(unsigned fixed, unsigned mx)
+  { std::lock_guard<std::mutex> g(lock_);
+    fixed_=fixed;
+    max_=mx?mx:1;
+    width_=(width_<max_)?width_:max_;
+    cv_.notify_all();
+  }
+
+  /** \returns the number of files to read or write at once right now. */
+  unsigned width()
+  { std::lock_guard<std::mutex> g(lock_);
+    return fixed_?fixed_:width_;
+  }
+
+  /** \returns the most files that will ever be in flight at once; how many threads to start. */
+  unsigned ceiling()
+  { std::lock_guard<std::mutex> g(lock_);
+    return fixed_?fixed_:max_;
+  }
+
+  /** Waits for room to start a file. */
+  void acquire()
+  { std::unique_lock<std::mutex> g(lock_);
+    while(busy_>=(fixed_?fixed_:width_))
+      cv_.wait(g);
+    if(!busy_++)
+      since_=clock::now();
+  }
+
+  /** Records a finished file of \a bytes bytes, and maybe moves the width. */
+  void release(size_t bytes)
+  { std::lock_guard<std::mutex> g(lock_);
+    clock::time_point now=clock::now();
+    bytes_+=bytes;
+    ++nfiles_;
+    if(!--busy_)
+      active_+=now-since_;
+    if(!fixed_)
+      climb_(now);
+    cv_.notify_all();
+  }
+
+  /** Gives back a slot taken with acquire() without finishing a file. */
+  void abandon()
+  { std::lock_guard<std::mutex> g(lock_);
+    if(!--busy_)
+      active_+=clock::now()-since_;
+    cv_.notify_all();
+  }
+
+private:
+  /** Ends the window once it has enough files and time to measure, and takes a step. */
+  void climb_(clock::time_point now)
+  { clock::duration t=active_+(busy_?now-since_:clock::duration(0));
+    double s=std::chrono::duration<double>(t).count(),rate;
+    if(nfiles_<2*width_ || s<0.02)
+      return;
+    rate=bytes_/s;
+    if(rate_>0 && rate<0.95*rate_) // got worse, so turn around
+      step_=-step_;
+    rate_=rate;
+    if(step_<0 && width_<=1)       step_=1;
+    else if(step_>0 && width_>=max_) step_=-1;
+    if(width_+step_>=1 && width_+step_<=max_)
+      width_+=step_;
+    bytes_=nfiles_=0;
+    active_=clock::duration(0);
+    since_=now;
+  }
+};
+
+struct slab_iter_t;
+struct writer_t;
+struct vmap_t;
+struct loader_t;
+
 //
 // === CONTEXT CLASS ===
 //
 
 /**
  * File context for ndio-series.
+ *
+ * The ndio_series_t base is the part that's visible through ndioGet().
  */
-struct series_t
+struct series_t:public ndio_series_t
 {
   std::string path_,     ///< the folder to search/put files
               pattern_;  ///< the filename pattern, should not include path elements
+  std::vector<std::string> parts_;  ///< the text around the file name fields; one more than there are fields
+  std::vector<unsigned>    widths_; ///< zero-padded width of each file name field, or 0 if unknown
   unsigned ndim_;        ///< the number of dimensions represented in the pattern
-  char     isr_,isw_;    ///< mode flags (readable, writeable)
+  char     isr_,isw_,isa_; ///< mode flags (readable, writeable, appending)
   size_t   last_;        ///< keeps track of last written position for appending
   int64_t  fdim_;        ///< number of dimensions for each file.  Not known until canseek() call.
+  nd_type_id_t ftype_;   ///< pixel type of the member files.  Not known until the first read or member_type().
+  scratch_t scratch_;    ///< holds a decoded member file when it has to be converted on read.
+  slab_iter_t *iter_;    ///< the active slab iterator, if any
+  writer_t *writer_;     ///< (async mode) the background writer
+  vmap_t   *vmap_;       ///< the demand-paged view of the series, if any
+  loader_t *loader_;     ///< the background load, if any
+  pack_t   *pack_,       ///< the series' pack file, if it was packed.  See ndio_series_params_t::pack.
+           *packer_;     ///< (pack mode) the pack being written
+  std::vector<std::string> failed_; ///< member files that couldn't be written since the last flush
+  std::mutex books_;     ///< guards failed_, hashes_ and the commit when several members are written at once
+  tuner_t  tuner_;       ///< how many member files to read or write at once
+  ndio_series_progress_fn progress_fn_; ///< called as ndioRead() and ndioWrite() finish each member, if not NULL
+  void    *progress_user_;
+  ndio_series_progress_t progress_; ///< of the read or write under way
+  std::mutex progress_lock_; ///< so the callback is called by one thread at a time
+  std::atomic<bool> cancelled_; ///< the callback asked to stop
+  xfer_stats_t total_;   ///< (stats mode) statistics of the last ndioRead()
+  size_t   hist_[NDIO_SERIES_HIST_BINS]; ///< (stats mode) total_'s histogram
+  std::vector<ndio_series_stats_t> planes_; ///< (stats mode) statistics of each member of the last ndioRead()
+  TPos     extents_;     ///< (stats mode) positions along each file name field, for indexing planes_
+  std::mutex stats_lock_;
+  std::string cdir_;     ///< canonical path_, for tile cache keys.
+  std::string home_;     ///< the folder in the series' name.  path_ is empty when striped.
+  std::string rootlist_; ///< copy of ndio_series_params_t::roots
+  std::vector<std::string> roots_; ///< the folders a striped series is spread over, or empty
 
   typedef std::string           TName;
   typedef std::map<TPos,TName>  TSeekTable;
+  typedef std::map<TName,uint64_t> THashTable;
+
+  /** A member file's size and mtime, as kept in the member size sidecar. */
+  struct member_stat_t
+  { uint64_t size;
+    uint64_t mtime;
+    bool operator!=(const member_stat_t& o) const { return size!=o.size || mtime!=o.mtime; }
+  };
+  typedef std::map<TName,member_stat_t> TStatTable;
 
   TSeekTable seektable_;
+  TPos       mn_,mx_;    ///< (watch mode) extents of the files in seektable_
+  TPos       fshape_;    ///< (watch mode) shape of the member files, once known
+  int        watch_;     ///< (watch mode) inotify descriptor, or -1
+  TStatTable pending_;   ///< (watch mode) listed files that may still be being written.  See settled_().
+  THashTable hashes_;    ///< content hashes of written member files, by file name.  See sidecar_name_().
+  THashTable hashes_new_; ///< the hashes recorded since the last save
+  bool       hashes_loaded_;
+  THashTable crcs_;      ///< CRC-32C of member files, by file name.  See crc_name_().
+  THashTable crcs_new_;  ///< the checksums recorded since the last save
+  bool       crcs_loaded_;
+  time_t     crcs_mtime_; ///< of the checksum sidecar when crcs_ was read
+  uint64_t   crcs_size_;
+  std::atomic<size_t> nbad_; ///< member files that failed verification since it was last reset
+  std::vector<TPos> labels_; ///< (compact mode) original number of each dense position, per field
+
+  /** A member file that's only been partly written by patch(). */
+  struct partial_t
+  { nd_t     a;      ///< the member's contents, or NULL if it's been written out to make room
+    size_t   filled; ///< number of pixels written so far
+    uint64_t tick;   ///< when it was last touched, for choosing what to write out
+  };
+  typedef std::map<TPos,partial_t> TPartials;
+  TPartials partial_;
+  size_t    partial_bytes_; ///< bytes held by partial_
+  uint64_t  tick_;
 
   regex_t ptn_field_,eg_field_;
 
@@ -198,20 +809,69 @@ struct series_t
    * Opens a file series from the filename pattern in \a path
    * according to the mode \a mode.
    * \param[in] path  A std::string with a valid filename pattern.
-   * \param[in] mode  May be "r", "w", or "rw".
+   * \param[in] mode  May be "r", "w", "rw" or "a".  In append mode the
+   *                  directory is listed once, here, and writes continue
+   *                  numbering the last file name field after the largest
+   *                  number found.
    */
   series_t(const std::string& path, const char* mode)
   : ndim_(0)
   , isr_(0)
   , isw_(0)
+  , isa_(0)
   , last_(0)
   , fdim_(-1)
+  , ftype_(nd_id_unknown)
+  , iter_(0)
+  , writer_(0)
+  , vmap_(0)
+  , loader_(0)
+  , pack_(0)
+  , packer_(0)
+  , progress_fn_(0)
+  , progress_user_(0)
+  , cancelled_(false)
+  , watch_(-1)
+  , hashes_loaded_(false)
+  , crcs_loaded_(false)
+  , crcs_mtime_(0)
+  , crcs_size_(0)
+  , nbad_(0)
+  , partial_bytes_(0)
+  , tick_(0)
   { char t[1024];
+    xfer_stats_init(&total_,0,1,0,0);
     std::string p(path);
     size_t n;
-    TRY(tre_regcomp(&ptn_field_,"%+",REG_EXTENDED)==0);               ///< Recognizes the "%" style filename patterns
+    params.scale=1.0;
+    params.offset=0.0;
+    params.lo=params.hi=0.0;
+    params.clamp=0;
+    params.incremental=0;
+    params.watch=0;
+    params.follow=0;
+    params.timeout_ms=-1;
+    params.durable=0;
+    params.batch=64;
+    params.compact=0;
+    params.write_budget=256ULL<<20;
+    params.async=0;
+    params.queue_budget=256ULL<<20;
+    params.pack=0;
+    params.roots=0;
+    params.stripe=NDIO_SERIES_STRIPE_ROUND_ROBIN;
+    params.threads=0;
+    params.max_threads=16;
+    params.stats=0;
+    params.hist_lo=params.hist_hi=0.0;
+    params.checksum=0;
+    params.verify=0;
+    tuner_.limit(params.threads,params.max_threads);
+    for(n=0;n<countof(params.dims);++n)
+      params.dims[n]=-1;
+    TRY(tre_regcomp(&ptn_field_,"%+(0[[:digit:]]+)?",REG_EXTENDED)==0); ///< Recognizes the "%" style filename patterns, with an optional "%04" style width
     TRY(tre_regcomp(&eg_field_,"\\.([[:digit:]]+)",REG_EXTENDED)==0); ///< Recognizes the "*.000.000.ext" example filename patterns.
-    TRY(parse_mode_string(mode,&isr_,&isw_));
+    TRY(parse_mode_string(mode,&isr_,&isw_,&isa_));
 #ifdef _MSC_VER
     GetFullPathName(path.c_str(),1024,t,NULL); // normalizes slashes for windows
     p.assign(t);
@@ -219,9 +879,10 @@ struct series_t
     n=p.rfind(PATHSEP[0]);
     { n=(n>=p.size())?0:n; // if not found set to 0
       path_=p.substr(0,n); // if PATHSEP not found will be ""
+      home_=path_;
       std::string name((n==0)?p:p.substr(n+1));
-      if(!gen_pattern_(name,ptn_field_,"([[:digit:]]+)"))
-        gen_pattern_(name,eg_field_,".([[:digit:]]+)");
+      if(!gen_pattern_(name,ptn_field_,"",false))
+        gen_pattern_(name,eg_field_,".",true);
 #if 0
       std::cout << "  INPUT: "<<path<<std::endl
                 << "   PATH: "<<path_<<std::endl
@@ -229,10 +890,51 @@ struct series_t
                 << "   NDIM: "<<ndim_<<std::endl;
 #endif
     }
+    if(isr_)
+      cdir_=canonical(dir_());
+    if(ndim_ && (isr_ || isa_))  // read from the pack if the series was packed
+    { struct stat st;
+      if(stat(pack_name_().c_str(),&st)==0)
+      { pack_=new pack_t;
+        if(!pack_->open_read(pack_name_()))
+        { LOG("%s(%d): %s()"ENDL "\tCould not read the pack index."ENDL "\t\t%s"ENDL,
+              __FILE__,__LINE__,__FUNCTION__,pack_name_().c_str());
+          ndim_=0;                // fails isok()
+        }
+      }
+    }
+    if(isa_ && ndim_)
+    { TPos mn,mx;
+      if(!minmax(mn,mx))
+        ndim_=0;                  // fails isok()
+      else if(!mx.empty())
+        last_=mx.back()+1;
+    }
   Error:
     ;
   }
 
+  ~series_t()
+  { end_load();
+    end_map();
+    end_slabs();
+    unwatch();
+    stop_writer();
+    if(!partial_.empty())
+    { flush_partial(0);
+      save_sidecars();
+    }
+    delete packer_;             // writes the index
+    delete pack_;
+  }
+
+  void end_slabs(); ///< Stops the slab iterator, if any.
+  void end_map();   ///< Releases the demand-paged view, if any.
+  void end_load();  ///< Cancels the background load, if any.
+  bool start_writer(); ///< Starts the background writer for async mode.
+  bool stop_writer();  ///< Finishes queued writes and stops the background writer.  \returns false if any failed.
+  void drain();        ///< Waits for queued writes to finish.
+
   /** Check validity. \returns true if series_t was opened properly, otherwise 0. */
   bool isok() { return ndim_>0; }
 
@@ -255,7 +957,8 @@ struct series_t
     TRY(tre_regcomp(&ptn,pattern_.c_str(),REG_EXTENDED)==0);
     TRY(isok());
     TRY((ndim_+1)<countof(matches));
-    if(tre_regexec(&ptn,nm,ndim_+1,matches,0)==0) 
+    if(tre_regexec(&ptn,nm,ndim_+1,matches,0)==0
+       && matches[0].rm_so==0 && nm[matches[0].rm_eo]=='\0') // whole name must match
     { for(unsigned i=1;i<=ndim_;++i)
       { char t=nm[matches[i].rm_eo];
         nm[matches[i].rm_eo]='\0';
@@ -302,19 +1005,17 @@ Error:
    * \param[in]   ipos  A std::vector with the position of the filename.
    */
   bool makename(std::string& out,std::vector<size_t> &ipos)
-  { char buf[128]={0};
-    std::string t=pattern_;
+  { std::string t;
+    bool ok;
     ipos.back()+=last_;
-    //(*ipos.rend())+=last_;
-    for (std::vector<size_t>::iterator it = ipos.begin(); it != ipos.end(); ++it)
-    { regex_t ptn;      
-      TRY(tre_regcomp(&ptn,"(\\[\\[:digit:\\]\\]\\+)",0)==0); //"\\(\\\\d\\+\\)"
-      snprintf(buf,countof(buf),"%llu",(unsigned long long)*it);
-      TRY(replace(&t,ptn,buf));
-    }
+    ok=name_(t,ipos);
     ipos.back()-=last_;
+    TRY(ok);
     out.clear();
-    if(!path_.empty())
+    if(!roots_.empty())
+    { out+=roots_[stripe_(ipos,t)];
+      out+=PATHSEP;
+    } else if(!path_.empty())
     { out+=path_;
       out+=PATHSEP;
     }
@@ -324,6 +1025,85 @@ Error:
     return 0;
   }
 
+  /** \returns which of roots_ the member at \a ipos, named \a name, goes in.  See ndio_series_params_t::stripe. */
+  size_t stripe_(const TPos& ipos, const std::string& name) const
+  { uint64_t k=0;
+    if(params.stripe==NDIO_SERIES_STRIPE_HASH)
+      k=hash64(name.data(),name.size(),0);
+    else
+      for(size_t i=0;i<ipos.size();++i)
+        k+=ipos[i];
+    return (size_t)(k%roots_.size());
+  }
+
+  /**
+   * Sets the roots of a striped series from \a list, or stops striping if
+   * \a list is NULL or empty.  See ndio_series_params_t::roots.
+   * \returns true on success, otherwise false.
+   */
+  bool set_roots(const char *list)
+  { const char sep=
+#ifdef _MSC_VER
+      ';';
+#else
+      ':';
+#endif
+    std::string l(list?list:"");
+    if(l!=rootlist_)
+    { size_t i,j;
+      rootlist_=l;
+      roots_.clear();
+      for(i=0;i<l.size();i=j+1)
+      { j=l.find(sep,i);
+        j=(j==std::string::npos)?l.size():j;
+        if(j>i) roots_.push_back(l.substr(i,j-i));
+      }
+      path_=roots_.empty()?home_:"";  // member names carry their root
+      cdir_=canonical(dir_());
+      seektable_.clear();
+      if(isa_)                         // continue after the last member on any root
+      { TPos mn,mx;
+        TRY(minmax(mn,mx));
+        last_=mx.empty()?0:mx.back()+1;
+      }
+    }
+    params.roots=rootlist_.empty()?0:rootlist_.c_str();
+    TRYMSG(roots_.empty() || !(params.watch || params.follow || params.pack),
+           "Striped series don't support watch, follow or pack.");
+    return true;
+Error:
+    return false;
+  }
+
+  /**
+   * Formats the file name, without the path, for position \a ipos.  Fields
+   * with a width are zero-padded to it.
+   * \returns true on success, otherwise false.
+   */
+  bool name_(std::string& out, const TPos& ipos) const
+  { char buf[64];
+    TRYMSG(ipos.size()==widths_.size(),"File name pattern and position have different numbers of fields.");
+    out=parts_[0];
+    for(size_t i=0;i<ipos.size();++i)
+    { snprintf(buf,countof(buf),"%0*llu",(int)widths_[i],(unsigned long long)ipos[i]);
+      out+=buf;
+      out+=parts_[i+1];
+    }
+    return true;
+Error:
+    return false;
+  }
+
+  /**
+   * \returns true if every file name field has a known width, so the file
+   * name for a position can be made without listing the directory.
+   */
+  bool fixed_width() const
+  { for(size_t i=0;i<widths_.size();++i)
+      if(!widths_[i]) return false;
+    return !widths_.empty();
+  }
+
   /**
    * Probes the series' path for matching files and determines the maximum
    * and minimum positions indicated by the filenames.
@@ -337,17 +1117,20 @@ Error:
    * \param[out] mx   A std::vector with the maxima.
    */
   bool minmax(TPos& mn, TPos& mx)
-  { DIR *dir=0;
-    struct dirent *ent=0;
-    TRYMSG(dir=opendir(path_.c_str()),strerror(errno));
-    while((ent=readdir(dir))!=NULL)
-    { TPos pos;
-      if(parse(ent->d_name,pos))
-      { vmin(mn,pos);
-        vmax(mx,pos);
-      }
+  { TListing listing;
+    if(params.compact || pack_)
+    { TSeekTable table;
+      return index(table,mn,mx);
     }
-    closedir(dir);
+    if(watching())
+    { TRY(poll_watch_());
+      mn=mn_;
+      mx=mx_;
+      return true;
+    }
+    TRY(list_(listing));
+    mn=listing->mn;
+    mx=listing->mx;
     return true;
   Error:
     LOG("\t%s"ENDL,path_.c_str());
@@ -356,17 +1139,33 @@ Error:
 
   /** \returns the shape of the first matching file in a series as an nd_t. */
   nd_t single_file_shape()
-  { DIR *dir=0;
-    struct dirent *ent;
-    TRYMSG(dir=opendir(path_.c_str()),strerror(errno));
-    while((ent=readdir(dir))!=NULL)
-    { TPos pos;
-      if(parse(ent->d_name,pos))
-      { nd_t shape=get_file_shape(path_,ent->d_name);
-        closedir(dir);
+  { TListing listing;
+    if(pack_)
+    { TSeekTable table;
+      TPos mn,mx;
+      const pack_entry_t *e;
+      nd_t shape=0;
+      TRY(index(table,mn,mx));
+      TRYMSG(!table.empty(),"Could not find files that matched the file series pattern.");
+      TRY(e=pack_->find(table.begin()->second));
+      TRY(shape=ndinit());
+      return ndreshape(ndcast(shape,e->type),(unsigned)e->shape.size(),&e->shape[0]);
+    }
+    if(watching())
+    { nd_t shape=0;
+      if(fshape_.empty())
+      { TRY(poll_watch_());
+        TRYMSG(!seektable_.empty(),"Could not find files that matched the file series pattern.");
+        TRY(shape=get_file_shape(path_,seektable_.begin()->second.c_str()));
+        fshape_.assign(ndshape(shape),ndshape(shape)+ndndim(shape));
+        ftype_=ndtype(shape);
         return shape;
       }
+      TRY(shape=ndinit());
+      return ndreshape(ndcast(shape,ftype_),(unsigned)fshape_.size(),&fshape_[0]);
     }
+    TRY(list_(listing));
+    return listing->shape(path_);
   Error:
     return 0;
   }
@@ -377,8 +1176,26 @@ Error:
    */
   bool find(std::string& out,TPos ipos)
   { TSeekTable::iterator it;
+    if(fixed_width() && !params.compact && !watching() && !pack_ && roots_.empty())
+    { std::string name;         // no need for the table
+      TRY(name_(name,ipos));
+      out.clear();
+      if(!path_.empty())
+      { out+=path_;
+        out+=PATHSEP;
+      }
+      out+=name;
+      return true;
+    }
     if(seektable_.empty())
       TRY(build_seek_table_());
+    if(params.compact)                // ipos is dense, seektable_ has the original numbers
+    { TRY(labels_.size()==ipos.size());
+      for(size_t i=0;i<ipos.size();++i)
+      { TRY(ipos[i]<labels_[i].size());
+        ipos[i]=labels_[i][ipos[i]];
+      }
+    }
     TRY((it=seektable_.find(ipos))!=seektable_.end());
     out.clear();
     if(!path_.empty())
@@ -398,27 +1215,38 @@ Error:
       Dimensions corresponding to whole file's are seekable.
   */
   unsigned canseek(size_t idim)
-  { DIR *dir=0;
-    struct dirent *ent;
+  { TListing listing;
     ndio_t file=0;
     nd_t shape=0; // I wish I didn't have to get this each time
-    TRYMSG(dir=opendir(path_.c_str()),strerror(errno));
-    while((ent=readdir(dir))!=NULL)
-    { TPos pos;
-      if(parse(ent->d_name,pos))
-      { unsigned out;
-        TRY(file=openfile(path_,ent->d_name));
-        TRY(shape=ndioShape(file));
-        fdim_=ndndim(shape);
-        if(idim<ndndim(shape))
-          out=ndioCanSeek(file,idim);
-        else
-          out=1;
-        ndfree(shape);
-        ndioClose(file);
-        closedir(dir);
-        return out;
-      }
+    if(pack_)
+    { TRY(shape=single_file_shape());
+      fdim_=ndndim(shape);
+      ndfree(shape);
+      return (int64_t)idim>=fdim_; // packed members are read whole, then cropped
+    }
+    if(watching() && !seektable_.empty())
+    { unsigned out;
+      TRY(file=openfile(path_,seektable_.begin()->second.c_str()));
+      TRY(shape=ndioShape(file));
+      fdim_=ndndim(shape);
+      out=(idim<ndndim(shape))?(caching()?0:ndioCanSeek(file,idim)):1;
+      ndfree(shape);
+      ndioClose(file);
+      return out;
+    }
+    TRY(list_(listing));
+    if(!listing->table.empty())
+    { unsigned out;
+      TRY(file=openfile(path_,listing->table.begin()->second.c_str()));
+      TRY(shape=ndioShape(file));
+      fdim_=ndndim(shape);
+      if(idim<ndndim(shape))
+        out=caching()?0:ndioCanSeek(file,idim); // cached members are read whole, then cropped
+      else
+        out=1;
+      ndfree(shape);
+      ndioClose(file);
+      return out;
     }
   Error:
     ndioClose(file);
@@ -426,39 +1254,2487 @@ Error:
     return 0;
   }
 
-  private:
-    /**
-     * Changes \a name if a pattern is found, but otherwise leaves it
-     * untouched.
-     * \returns true if a pattern is detected, otherwise false.
-     */
-    bool gen_pattern_(std::string& name, const regex_t& re, const char* repl)
-    { 
-      ndim_=replace(&name,re,repl);
-      if(ndim_) pattern_=name;
-      return ndim_>0;
+  /**
+   * Reads the member \a file into \a dst.
+   *
+   * When the member's pixel type differs from \a dst, or \a params asks for
+   * a scale, offset or clamp, the member is decoded into \a scratch and
+   * converted as it's copied into \a dst.  Only one member's worth of
+   * scratch space is ever held.
+   *
+   * \param[in]     file  An open member file.
+   * \param[in,out] dst   The destination.  Only the leading dimensions that
+   *                      the member file covers are written.
+   * \param[in]     pos   If not NULL, read the sub-array of the member at
+   *                      \a pos with the shape of \a dst.  Otherwise read the
+   *                      whole member.
+   * \param[in]     scratch Decoding space.  Defaults to the series' own,
+   *                      threads other than the caller's must pass theirs.
+   *                      Its \a stats, if set, count the values written.
+   * \returns true on success, otherwise false.
+   */
+  bool read_member(ndio_t file, nd_t dst, size_t *pos, scratch_t *scratch=0)
+  { nd_t shape=0,buf=0;
+    xfer_op_t op={params.scale,params.offset,params.lo,params.hi,(int)params.clamp};
+    if(!scratch)
+      scratch=&scratch_;
+    if(ftype_==nd_id_unknown)
+    { TRY(shape=ndioShape(file));
+      ftype_=ndtype(shape);
     }
-
-    /**
-     * Build seek table by searching through the \a path_ and locating parsable
-     * files.  The parsed positions are inserted into the \a seektable_.
-     * \returns true on success, otherwise false.
-     */
-    bool build_seek_table_()
-    { DIR *dir=0;
-      struct dirent *ent;
-      TRYMSG(dir=opendir(path_.c_str()),strerror(errno));
-      seektable_.clear();
-      while((ent=readdir(dir))!=NULL)
-      { TPos pos;
-        if(parse(ent->d_name,pos))
-          seektable_[pos]=ent->d_name;
+    if(ftype_==ndtype(dst) && xfer_is_identity(&op))
+    { if(pos) TRY(ndioReadSubarray(file,dst,pos,NULL));
+      else    TRY(ndioRead(file,dst));
+      if(scratch->stats)             // nothing was copied, so count what was read
+      { size_t sh[32];
+        unsigned i,n=ndndim(dst);
+        if(!pos)                     // just the leading dimensions the member covers
+        { if(!shape)
+            TRY(shape=ndioShape(file));
+          n=(ndndim(shape)<n)?ndndim(shape):n;
+        }
+        TRY(n<=countof(sh));
+        for(i=0;i<n;++i)
+          sh[i]=(!pos && ndshape(shape)[i]<ndshape(dst)[i])?ndshape(shape)[i]:ndshape(dst)[i];
+        TRY(xfer_stats(nddata(dst),ndstrides(dst),ndtype(dst),n,sh,scratch->stats));
       }
+      ndfree(shape);
       return true;
+    }
+    if(!shape)
+      TRY(shape=ndioShape(file));
+    { size_t sh[32];
+      unsigned i,n=ndndim(shape);
+      TRY(n<=countof(sh));
+      n=(n<ndndim(dst))?n:ndndim(dst);
+      if(pos)
+      { TRY(buf=scratch->reshape(ndtype(shape),ndndim(dst),ndshape(dst)));
+        TRY(ndioReadSubarray(file,buf,pos,NULL));
+      } else
+      { TRY(buf=scratch->reshape(ndtype(shape),ndndim(shape),ndshape(shape)));
+        TRY(ndioRead(file,buf));
+      }
+      for(i=0;i<n;++i)
+        sh[i]=(ndshape(buf)[i]<ndshape(dst)[i])?ndshape(buf)[i]:ndshape(dst)[i];
+      TRYMSG(xfer(nddata(dst),ndstrides(dst),ndtype(dst),
+                  nddata(buf),ndstrides(buf),ndtype(buf),
+                  n,sh,&op,scratch->stats),"Unsupported pixel type conversion.");
+    }
+    ndfree(shape);
+    return true;
 Error:
-      return false;
+    ndfree(shape);
+    return false;
+  }
+
+  /**
+   * Lists the member files with their positions, and their extents.
+   * In watch mode this is a copy of the live index, otherwise the directory
+   * is listed.
+   * \returns true on success, otherwise false.
+   */
+  bool index(TSeekTable& table, TPos& mn, TPos& mx)
+  { if(!watching())
+      TRY(scan_(table,mn,mx));
+    else
+    { TRY(poll_watch_());
+      table=seektable_;
+      mn=mn_;
+      mx=mx_;
     }
-};
+    if(params.compact)
+      compact_(table,mn,mx);
+    return true;
+Error:
+    return false;
+  }
+
+  /**
+   * \returns the original numbers of the dense positions along file name
+   * field \a ifield, in increasing order, with their count in \a n.
+   * Compact mode only.
+   */
+  const size_t* field_labels(unsigned ifield, size_t *n)
+  { TPos mn,mx;
+    TRYMSG(params.compact,"Labels are only kept in compact mode.");
+    TRY(ifield<ndim_);
+    if(labels_.empty())
+      TRY(minmax(mn,mx));
+    TRY(ifield<labels_.size() && !labels_[ifield].empty());
+    if(n) *n=labels_[ifield].size();
+    return &labels_[ifield][0];
+Error:
+    if(n) *n=0;
+    return 0;
+  }
+
+  /**
+   * Sets \a fd to the dimension of an \a ndim dimensional array indexed by
+   * each file name field.  See ndio_series_params_t::dims.
+   * \returns true on success, false if the mapping isn't valid.
+   */
+  bool field_dims(std::vector<unsigned>& fd, unsigned ndim)
+  { fd.clear();
+    TRYMSG(ndim>=ndim_ && ndim_<=NDIO_SERIES_MAX_FIELDS,"Array has too few dimensions for the series.");
+    for(unsigned i=0;i<ndim_;++i)
+    { int d=(params.dims[0]<0)?(int)(ndim-ndim_+i):params.dims[i];
+      TRYMSG(d>=0 && (unsigned)d<ndim,"Invalid dimension for a file name field.");
+      for(size_t k=0;k<fd.size();++k)
+        TRYMSG(fd[k]!=(unsigned)d,"Two file name fields index the same dimension.");
+      fd.push_back((unsigned)d);
+    }
+    return true;
+Error:
+    return false;
+  }
+
+  /** \returns true if \a fd names the last dimensions of an \a ndim dimensional array, in order. */
+  static bool trailing(const std::vector<unsigned>& fd, unsigned ndim)
+  { for(size_t i=0;i<fd.size();++i)
+      if(fd[i]!=ndim-fd.size()+i)
+        return false;
+    return true;
+  }
+
+  /**
+   * Copies the member slab of \a src at file name position \a ipos into
+   * \a scratch, or the series' own scratch space if that's NULL.  The
+   * dimensions of \a src in \a fd are the file name fields, the others make
+   * up the slab.
+   *
+   * Only one member's worth of memory is used, so writing along leading
+   * dimensions doesn't need a transposed copy of the whole array.
+   *
+   * \returns the slab on success, otherwise NULL.
+   */
+  nd_t gather(nd_t src, const std::vector<unsigned>& fd, const std::vector<size_t>& ipos,
+              scratch_t *scratch=0)
+  { size_t shape[32],strides[32];
+    unsigned n;
+    const char *p;
+    nd_t m=0;
+    TRY(ndndim(src)<=countof(shape));
+    p=member_view(src,fd,&ipos[0],shape,strides,&n);
+    TRY(m=(scratch?scratch:&scratch_)->reshape(ndtype(src),n,shape));
+    TRYMSG(xfer(nddata(m),ndstrides(m),ndtype(m),p,strides,ndtype(src),n,shape,NULL),
+           "Unsupported pixel type.");
+    return m;
+Error:
+    return 0;
+  }
+
+  /**
+   * Reads the member \a file into the part of \a dst at file name position
+   * \a ipos.  The dimensions of \a dst in \a fd are the file name fields; the
+   * member is scattered across the others, in order, and converted as in
+   * read_member().  \a scratch is as for read_member().
+   * \returns true on success, otherwise false.
+   */
+  bool scatter(const std::string& name, nd_t dst, const std::vector<unsigned>& fd, const size_t *ipos,
+               scratch_t *scratch=0)
+  { nd_t buf=0;
+    size_t sh[32],st[32];
+    unsigned i,n;
+    char *p;
+    xfer_op_t op={params.scale,params.offset,params.lo,params.hi,(int)params.clamp};
+    TTile tile;
+    if(!scratch)
+      scratch=&scratch_;
+    TRY(ndndim(dst)<=countof(sh));
+    if(caching())
+    { TRY(cached(name,tile));
+      buf=tile->a;
+    } else
+      TRY(buf=decode(name,scratch));
+    p=member_view(dst,fd,ipos,sh,st,&n);
+    n=(n<ndndim(buf))?n:ndndim(buf);
+    for(i=0;i<n;++i)
+      sh[i]=(ndshape(buf)[i]<sh[i])?ndshape(buf)[i]:sh[i];
+    TRYMSG(xfer(p,st,ndtype(dst),nddata(buf),ndstrides(buf),ndtype(buf),n,sh,&op,scratch->stats),
+           "Unsupported pixel type conversion.");
+    return true;
+Error:
+    return false;
+  }
+
+  /**
+   * (stats mode) Starts collecting statistics for a read into an array of
+   * type \a type, whose file name fields span \a mn to \a mx.
+   */
+  void stats_begin(nd_type_id_t type, const TPos& mn, const TPos& mx)
+  { double lo=params.hist_lo,hi=params.hist_hi;
+    size_t n=1;
+    if(lo==hi)                       // default to the type's range
+      type_range(type,&lo,&hi);
+    xfer_stats_init(&total_,lo,hi,NDIO_SERIES_HIST_BINS,hist_);
+    extents_.resize(mn.size());
+    for(size_t i=0;i<mn.size();++i)
+      n*=(extents_[i]=mx[i]-mn[i]+1);
+    planes_.assign(n,ndio_series_stats_t());
+  }
+
+  /** (stats mode) Stops collecting statistics.  ndioSeriesStats() then has nothing to report. */
+  void stats_clear()
+  { planes_.clear();
+    xfer_stats_init(&total_,0,1,0,0);
+  }
+
+  /**
+   * Calls \a read() with \a scratch counting the values it writes, and adds
+   * them to the statistics for the member at \a ipos.  Just calls \a read()
+   * when statistics aren't being collected.
+   * \returns what \a read() returns.
+   */
+  template<typename F> bool counted(scratch_t *scratch, const size_t *ipos, F read)
+  { xfer_stats_t st;
+    size_t hist[NDIO_SERIES_HIST_BINS],k=0,stride=1;
+    bool ok;
+    if(planes_.empty())
+      return read();
+    xfer_stats_init(&st,total_.lo,total_.hi,NDIO_SERIES_HIST_BINS,hist);
+    scratch->stats=&st;
+    ok=read();
+    scratch->stats=0;
+    if(!ok)
+      return false;
+    for(size_t i=0;i<extents_.size();++i)
+    { k+=ipos[i]*stride;
+      stride*=extents_[i];
+    }
+    { std::lock_guard<std::mutex> g(stats_lock_);
+      ndio_series_stats_t& p=planes_[k];
+      p.min=st.min;
+      p.max=st.max;
+      p.mean=st.n?st.sum/st.n:0.0;
+      p.count=st.n;
+      xfer_stats_merge(&total_,&st);
+    }
+    return true;
+  }
+
+  /** Sets [\a lo,\a hi) to cover the values of \a type; [0,1) for floating point. */
+  static void type_range(nd_type_id_t type, double *lo, double *hi)
+  { switch(type)
+    { case nd_u8:  *lo=0;           *hi=256.0;         break;
+      case nd_u16: *lo=0;           *hi=65536.0;       break;
+      case nd_u32: *lo=0;           *hi=4294967296.0;  break;
+      case nd_u64: *lo=0;           *hi=18446744073709551616.0; break;
+      case nd_i8:  *lo=-128.0;      *hi=128.0;         break;
+      case nd_i16: *lo=-32768.0;    *hi=32768.0;       break;
+      case nd_i32: *lo=-2147483648.0; *hi=2147483648.0; break;
+      case nd_i64: *lo=-9223372036854775808.0; *hi=9223372036854775808.0; break;
+      default:     *lo=0;           *hi=1.0;
+    }
+  }
+
+  /** Starts counting progress for an ndioRead() or ndioWrite() of \a total member files. */
+  void progress_begin(size_t total)
+  { progress_.done=0;
+    progress_.total=total;
+    progress_.bytes=0;
+    cancelled_=false;
+  }
+
+  /**
+   * Counts a member file of \a bytes as done and tells the progress
+   * callback, if there is one.
+   * \returns false once the callback has asked to cancel, otherwise true.
+   */
+  bool progressed(size_t bytes)
+  { if(!progress_fn_)
+      return true;
+    std::lock_guard<std::mutex> g(progress_lock_);
+    ++progress_.done;
+    progress_.bytes+=bytes;
+    if(!cancelled_ && progress_fn_(&progress_,progress_user_)==NDIO_SERIES_CANCEL)
+      cancelled_=true;
+    return !cancelled_;
+  }
+
+  /**
+   * Ends counting progress.
+   * \returns false if the callback cancelled, otherwise true.
+   */
+  bool progress_end()
+  { bool ok=!cancelled_;
+    cancelled_=false;
+    return ok;
+  }
+
+  /**
+   * Learns the pixel type of the member files, which read_member() would
+   * otherwise set on the first read.  Call while there's one thread, before
+   * starting others that read.  \a type, if known, saves looking it up.
+   * \returns true on success, otherwise false.
+   */
+  bool member_type(nd_type_id_t type=nd_id_unknown)
+  { nd_t shape=0;
+    if(ftype_!=nd_id_unknown)
+      return true;
+    if(type==nd_id_unknown)
+    { TRY(shape=single_file_shape());
+      type=ndtype(shape);
+      ndfree(shape);
+    }
+    ftype_=type;
+    return true;
+  Error:
+    return false;
+  }
+
+  /**
+   * Calls \a job(i,scratch) for each \a i in [0,n), with as many calls at
+   * once as the tuner allows.  Each thread has its own \a scratch.  \a bytes
+   * is the size of one member, for measuring throughput.  Stops starting
+   * calls once the progress callback cancels.
+   * \returns the number of calls that failed.
+   */
+  size_t run(size_t n, size_t bytes, const std::function<bool(size_t,scratch_t*)>& job)
+  { std::vector<std::thread> threads;
+    std::atomic<size_t> next(0),nfailed(0);
+    size_t nthreads=(std::min)((size_t)tuner_.ceiling(),n);
+    std::function<void()> work=[&]()
+    { scratch_t scratch;
+      size_t i;
+      while(!cancelled_ && (i=next++)<n)
+      { tuner_.acquire();
+        if(!job(i,&scratch))
+          ++nfailed;
+        tuner_.release(bytes);
+      }
+    };
+    for(size_t i=1;i<nthreads;++i)
+      threads.push_back(std::thread(work));
+    work();
+    for(size_t i=0;i<threads.size();++i)
+      threads[i].join();
+    return nfailed;
+  }
+
+  /**
+   * Reads \a members, whose positions start at \a mn, into \a dst several
+   * at a time.  Each member is scattered into its own part of \a dst.  Like
+   * series_read(), members that fail to read are skipped.
+   */
+  void read_parallel(const TSeekTable& members, const TPos& mn, nd_t dst, const std::vector<unsigned>& fd)
+  { std::vector<TSeekTable::const_iterator> work;
+    TSeekTable::const_iterator it;
+    for(it=members.begin();it!=members.end();++it)
+      work.push_back(it);
+    const size_t bytes=member_bytes(dst,fd);
+    run(work.size(),bytes,[&](size_t i,scratch_t *scratch)
+    { TPos ipos(work[i]->first);
+      bool ok;
+      for(size_t k=0;k<ndim_;++k)
+        ipos[k]-=mn[k];
+      ok=counted(scratch,&ipos[0],[&]()
+      { return scatter(work[i]->second,dst,fd,&ipos[0],scratch);
+      });
+      progressed(bytes);
+      return ok;
+    });
+  }
+
+  /** \returns the bytes of one member's part of \a a, whose file name fields are the dimensions in \a fd. */
+  static size_t member_bytes(nd_t a, const std::vector<unsigned>& fd)
+  { size_t n=ndnbytes(a);
+    for(size_t i=0;i<fd.size();++i)
+      n/=ndshape(a)[fd[i]]?ndshape(a)[fd[i]]:1;
+    return n;
+  }
+
+  /**
+   * Decodes the whole member \a name into \a scratch.
+   * \returns the member on success, otherwise NULL.
+   */
+  nd_t decode(const std::string& name, scratch_t *scratch)
+  { nd_t buf=0,shape=0;
+    ndio_t file=0;
+    if(pack_)
+    { const pack_entry_t *e;
+      TRYMSG(e=pack_->find(name),name.c_str());
+      TRY(buf=scratch->reshape(e->type,(unsigned)e->shape.size(),&e->shape[0]));
+      TRYMSG(ndnbytes(buf)==e->nbytes,"Corrupt pack entry.");
+      TRYMSG(pack_->read(*e,nddata(buf)),strerror(errno));
+      return buf;
+    }
+    { std::future<bool> good=check(full_(name));
+      TRY(file=openfile(path_,name.c_str()));
+      TRY(shape=ndioShape(file));
+      TRY(buf=scratch->reshape(ndtype(shape),ndndim(shape),ndshape(shape)));
+      TRY(ndioRead(file,buf));
+      TRY(good.get());
+    }
+    ndfree(shape);
+    ndioClose(file);
+    return buf;
+Error:
+    ndfree(shape);
+    ndioClose(file);
+    return 0;
+  }
+
+  /**
+   * Reads the member \a name into \a dst, like read_member(), from its own
+   * file or from the pack.
+   *
+   * Packed members whose type and layout already match \a dst are read
+   * straight into place; otherwise they're read into \a scratch and copied.
+   *
+   * \returns true on success, otherwise false.
+   */
+  bool read_named(const std::string& name, nd_t dst, size_t *pos, scratch_t *scratch=0)
+  { nd_t buf=0;
+    if(!scratch)
+      scratch=&scratch_;
+    if(caching())
+    { TTile tile;
+      TRY(cached(name,tile));
+      return crop(tile->a,dst,pos,scratch->stats);
+    }
+    if(!pack_)
+    { std::future<bool> good=check(full_(name));
+      ndio_t file=0;
+      bool ok;
+      TRY(file=openfile(path_,name.c_str()));
+      ok=read_member(file,dst,pos,scratch);
+      ndioClose(file);
+      return good.get() && ok;
+    }
+    { const pack_entry_t *e;
+      xfer_op_t op={params.scale,params.offset,params.lo,params.hi,(int)params.clamp};
+      size_t i,n=ndndim(dst),expect=ndbpp(dst);
+      bool direct=!pos && xfer_is_identity(&op);
+      TRYMSG(e=pack_->find(name),name.c_str());
+      n=(n<e->shape.size())?n:e->shape.size();
+      direct=direct && ndtype(dst)==e->type && n==e->shape.size();
+      for(i=0;direct && i<n;++i)     // dst holds the member contiguously?
+      { direct=ndshape(dst)[i]==e->shape[i] && ndstrides(dst)[i]==expect;
+        expect*=e->shape[i];
+      }
+      if(direct)
+      { TRYMSG(expect==e->nbytes,"Corrupt pack entry.");
+        TRYMSG(pack_->read(*e,nddata(dst)),strerror(errno));
+        if(scratch->stats)
+          TRY(xfer_stats(nddata(dst),ndstrides(dst),ndtype(dst),(unsigned)n,&e->shape[0],scratch->stats));
+        return true;
+      }
+      TRY(buf=decode(name,scratch));
+      return crop(buf,dst,pos,scratch->stats);
+    }
+Error:
+    return false;
+  }
+
+  /**
+   * Copies the part of the decoded member \a buf at \a pos, or all of it if
+   * \a pos is NULL, into \a dst.  Converts as in read_member().  The values
+   * written are added to \a stats if it isn't NULL.
+   * \returns true on success, otherwise false.
+   */
+  bool crop(nd_t buf, nd_t dst, const size_t *pos, xfer_stats_t *stats=0)
+  { xfer_op_t op={params.scale,params.offset,params.lo,params.hi,(int)params.clamp};
+    size_t sh[32],i,n=ndndim(dst);
+    const char *p=(const char*)nddata(buf);
+    n=(n<ndndim(buf))?n:ndndim(buf);
+    TRY(n<=countof(sh));
+    for(i=0;i<n;++i)
+    { size_t o=pos?pos[i]:0;
+      TRY(o<=ndshape(buf)[i]);
+      p+=o*ndstrides(buf)[i];
+      sh[i]=ndshape(buf)[i]-o;
+      sh[i]=(ndshape(dst)[i]<sh[i])?ndshape(dst)[i]:sh[i];
+    }
+    TRYMSG(xfer(nddata(dst),ndstrides(dst),ndtype(dst),p,ndstrides(buf),ndtype(buf),
+                (unsigned)n,sh,&op,stats),"Unsupported pixel type conversion.");
+    return true;
+Error:
+    return false;
+  }
+
+  /** \returns the path of the member file \a name. */
+  std::string full_(const std::string& name) const
+  { return path_.empty()?name:path_+PATHSEP+name;
+  }
+
+  /** \returns true if reads go through the tile cache.  See ndioSeriesCacheBudget(). */
+  bool caching() { return !pack_ && tiles().budget()>0; }
+
+  /**
+   * Gets the decoded member \a name from the tile cache, decoding it and
+   * adding it on a miss.
+   * \returns true on success, otherwise false.
+   */
+  bool cached(const std::string& name, TTile& out)
+  { std::string full(full_(name)),
+                key((cdir_.empty()?dir_():cdir_)+PATHSEP+name);
+    struct stat st;
+    nd_t shape=0;
+    ndio_t file=0;
+    std::future<bool> good;
+    TRYMSG(stat(full.c_str(),&st)==0,strerror(errno));
+    if((out=tiles().get(key,st)))
+      return true;
+    out=std::make_shared<tile_t>();
+    good=check(full);
+    TRY(file=openfile(path_,name.c_str()));
+    TRY(shape=ndioShape(file));
+    TRY(out->a=ndinit());
+    TRY(ndreshape(ndcast(out->a,ndtype(shape)),ndndim(shape),ndshape(shape)));
+    TRY(ndref(out->a,malloc(ndnbytes(shape)),nd_heap));
+    TRY(nddata(out->a));
+    TRY(ndioRead(file,out->a));
+    TRY(good.get());                 // don't cache a corrupt member
+    out->mtime=st.st_mtime;
+    out->size=(uint64_t)st.st_size;
+    out->racy=time(NULL)<=st.st_mtime+1;
+    tiles().put(key,out);
+    ndfree(shape);
+    ndioClose(file);
+    return true;
+Error:
+    LOG("\t%s"ENDL,full.c_str());
+    ndfree(shape);
+    ndioClose(file);
+    out.reset();
+    return false;
+  }
+
+  /**
+   * Writes \a m as the member file at file name position \a ipos.
+   *
+   * In incremental mode the file is skipped if its content hasn't changed.
+   * If \a commit is not NULL the file is written under a temporary name and
+   * queued with \a commit.
+   *
+   * \returns true on success, otherwise false.
+   */
+  bool put(TPos ipos, nd_t m, commit_t *commit)
+  { std::string outname,name;
+    uint64_t h=0;
+    ndio_t f=0;
+    unsigned ok;
+    TRY(makename(outname,ipos));
+    if(params.pack)
+    { if(!packer_)
+      { packer_=new pack_t;
+        TRYMSG(packer_->open_write(pack_name_(),isa_!=0),strerror(errno));
+      }
+      name=outname.substr(path_.empty()?0:path_.size()+1); // members are keyed by their bare name
+      TRYMSG(packer_->add(name,m),strerror(errno));
+      return true;
+    }
+    if(params.incremental)
+    { h=hash_nd(m);
+      std::lock_guard<std::mutex> g(books_);
+      if(unchanged(outname,h))
+        return true;
+    }
+    name=commit?commit_t::tmpname(outname):outname;
+    f=ndioOpen(name.c_str(),NULL,"w");
+    ok=(ndioWrite(f,m)!=NULL);
+    ndioClose(f);
+    TRYMSG(ok,name.c_str());
+    if(params.checksum)              // while the file's still in the page cache
+      TRY(record_crc(name,outname));
+    { std::lock_guard<std::mutex> g(books_);
+      if(commit)
+        TRY(commit->add(name,outname));
+      if(params.incremental)
+        record(outname,h);
+    }
+    return true;
+Error:
+    { std::lock_guard<std::mutex> g(books_);
+      failed_.push_back(outname);
+    }
+    return false;
+  }
+
+  /**
+   * Writes the part of the series covered by \a src, which sits at \a origin
+   * in an array of shape \a shape.  The file name fields are the last
+   * dimensions.
+   *
+   * Members that \a src covers completely are written straight away.  The
+   * rest are collected in memory (starting from the file on disk if there
+   * is one) and written once they're complete.  When more than
+   * ndio_series_params_t::write_budget bytes are held, the least recently
+   * touched members are written out as they are and read back if touched
+   * again.
+   *
+   * \returns true on success, otherwise false.
+   */
+  bool patch(nd_t src, const size_t *origin, const size_t *shape, commit_t *commit)
+  { const unsigned n=ndndim(src),fdim=n-ndim_;
+    TPos ipos,lo,hi,mshape;
+    size_t npx=1,mpx=1;
+    bool whole=true;
+    unsigned i;
+    TRYMSG(params.dims[0]<0,"Sub-array writes don't support remapped series dimensions.");
+    TRYMSG(n>ndim_,"Sub-array has too few dimensions.");
+    for(i=0;i<n;++i)
+      TRYMSG(origin[i]+ndshape(src)[i]<=shape[i],"Sub-array doesn't fit in the series.");
+    for(i=0;i<fdim;++i)
+    { mshape.push_back(shape[i]);
+      npx*=ndshape(src)[i];
+      mpx*=shape[i];
+      whole=whole && origin[i]==0 && ndshape(src)[i]==shape[i];
+    }
+    for(i=fdim;i<n;++i)
+    { lo.push_back(origin[i]);
+      hi.push_back(origin[i]+ndshape(src)[i]);
+    }
+    if(!ndnelem(src)) return true;
+    for(ipos=lo;ipos.back()<hi.back();)
+    { TPartials::iterator it=partial_.find(ipos);
+      for(i=0;i<ndim_;++i)
+        ndoffset(src,fdim+i,ipos[i]-lo[i]);
+      ndsetndim(src,fdim);
+      if(whole && it==partial_.end())
+      { if(!put(ipos,src,commit) && commit)
+          goto Restore;
+      } else
+      { partial_t *p;
+        char *d;
+        TRY(p=partial(ipos,ndtype(src),mshape,commit));
+        d=(char*)nddata(p->a);
+        for(i=0;i<fdim;++i)
+          d+=origin[i]*ndstrides(p->a)[i];
+        TRYMSG(xfer(d,ndstrides(p->a),ndtype(p->a),nddata(src),ndstrides(src),ndtype(src),
+                    fdim,ndshape(src),NULL),"Unsupported pixel type.");
+        if((p->filled+=npx)>=mpx)     // complete
+        { bool ok=put(ipos,p->a,commit);
+          release_(partial_.find(ipos));
+          if(!ok && commit)
+            goto Restore;
+        }
+      }
+      ndsetndim(src,n);
+      for(i=0;i<ndim_;++i)
+        ndoffset(src,fdim+i,-(int64_t)(ipos[i]-lo[i]));
+      for(i=0;i<ndim_;++i)           // next position, first field fastest
+      { if(++ipos[i]<hi[i]) break;
+        if(i+1<ndim_) ipos[i]=lo[i];
+      }
+    }
+    return true;
+Restore:
+Error:
+    if(ndndim(src)!=n)
+    { ndsetndim(src,n);
+      for(i=0;i<ndim_;++i)
+        ndoffset(src,fdim+i,-(int64_t)(ipos[i]-lo[i]));
+    }
+    return false;
+  }
+
+  /**
+   * Writes out every partly written member, as it is.
+   * \returns true on success, otherwise false.
+   */
+  bool flush_partial(commit_t *commit)
+  { bool ok=true;
+    while(!partial_.empty())
+    { TPartials::iterator it=partial_.begin();
+      if(it->second.a)
+        ok=put(it->first,it->second.a,commit) && ok;
+      release_(it);
+    }
+    return ok;
+  }
+
+  /** \returns true if the index is being kept up to date with inotify. */
+  bool watching() const { return watch_>=0; }
+
+  /**
+   * Starts watch mode.
+   *
+   * The directory is listed once to seed seektable_ and the extents.  After
+   * that, files that are closed after writing or moved into the directory
+   * are added as inotify reports them, and deleted files are dropped, so
+   * shape queries and seeks don't have to list the directory again.
+   *
+   * \returns true on success, otherwise false.
+   */
+  bool watch()
+  {
+#ifdef HAVE_INOTIFY
+    if(watching()) return true;
+    TRYMSG((watch_=inotify_init1(IN_NONBLOCK|IN_CLOEXEC))>=0,strerror(errno));
+    // Add the watch before listing so files created in between aren't missed.
+    TRYMSG(inotify_add_watch(watch_,dir_().c_str(),
+                             IN_CLOSE_WRITE|IN_MOVED_TO|IN_DELETE|IN_MOVED_FROM)>=0,
+           strerror(errno));
+    TRY(build_seek_table_());
+    return true;
+Error:
+    unwatch();
+    LOG("\t%s"ENDL,dir_().c_str());
+    return false;
+#else
+    FAIL("Watch mode requires inotify (Linux).");
+Error:
+    return false;
+#endif
+  }
+
+  /**
+   * (follow mode) Waits until the member file at \a ipos has been written
+   * and closed by its writer, or, if \a ipos is NULL, until any member file
+   * has.  Blocks on the inotify descriptor rather than polling the directory,
+   * so a waiting seek wakes as soon as the writer closes the file.
+   *
+   * Gives up after \a params.timeout_ms milliseconds unless that's negative.
+   *
+   * \returns true if the file is available, otherwise false.
+   */
+  bool wait(const TPos *ipos)
+  {
+#ifdef HAVE_INOTIFY
+    struct timespec t0,t1;
+    TRYMSG(watching(),"Follow mode requires watch mode.");
+    clock_gettime(CLOCK_MONOTONIC,&t0);
+    for(;;)
+    { struct pollfd p={watch_,POLLIN,0};
+      int remaining=-1;
+      TRY(poll_watch_());
+      if(ipos?(seektable_.find(*ipos)!=seektable_.end()):!seektable_.empty())
+        return true;
+      if(params.timeout_ms>=0)
+      { clock_gettime(CLOCK_MONOTONIC,&t1);
+        remaining=params.timeout_ms
+                 -(int)((t1.tv_sec-t0.tv_sec)*1000+(t1.tv_nsec-t0.tv_nsec)/1000000);
+        TRYMSG(remaining>0,"Timed out waiting for a member file.");
+      }
+      if(!pending_.empty() && (remaining<0 || remaining>1000))
+        remaining=1000;               // pending files may settle without an event
+      TRYMSG(poll(&p,1,remaining)>=0 || errno==EINTR,strerror(errno));
+    }
+Error:
+#endif
+    return false;
+  }
+
+  /** Stops watch mode. */
+  void unwatch()
+  {
+#ifdef HAVE_INOTIFY
+    if(watch_>=0) close(watch_);
+#endif
+    watch_=-1;
+    fshape_.clear();
+    pending_.clear();
+  }
+
+  /**
+   * For incremental writes.
+   * \returns true if the member file \a outname exists and was last written
+   *          by this plugin with content hashing to \a h.
+   */
+  bool unchanged(const std::string& outname, uint64_t h)
+  { struct stat st;
+    THashTable::iterator it;
+    if(!load_hashes_()) return false;
+    if((it=hashes_.find(basename_(outname)))==hashes_.end()) return false;
+    if(it->second!=h) return false;
+    return stat(outname.c_str(),&st)==0;
+  }
+
+  /** For incremental writes.  Remember that \a outname was written with content hashing to \a h. */
+  void record(const std::string& outname, uint64_t h)
+  { hashes_[basename_(outname)]=hashes_new_[basename_(outname)]=h;
+  }
+
+  /**
+   * For incremental writes.  Saves the content hashes to the sidecar file.
+   * The sidecar is replaced atomically so an interrupted write can't leave
+   * hashes for files that weren't written.
+   * \returns true on success, otherwise false.
+   */
+  bool save_hashes()
+  { TRYMSG(save_table_(sidecar_name_(),hashes_new_,16,hashes_),sidecar_name_().c_str());
+    hashes_new_.clear();
+    return true;
+Error:
+    return false;
+  }
+
+  /**
+   * For checksum mode.  Remembers the CRC-32C of the member file \a path,
+   * which was written as \a outname.
+   * \returns true on success, otherwise false.
+   */
+  bool record_crc(const std::string& path, const std::string& outname)
+  { uint32_t crc;
+    TRYMSG(crc32c_file(path.c_str(),&crc),path.c_str());
+    { std::lock_guard<std::mutex> g(books_);
+      refresh_crcs_();
+      crcs_[basename_(outname)]=crcs_new_[basename_(outname)]=crc;
+    }
+    return true;
+Error:
+    return false;
+  }
+
+  /** For checksum mode.  Saves the checksums to their sidecar, like save_hashes(). */
+  bool save_crcs()
+  { std::lock_guard<std::mutex> g(books_);
+    struct stat st;
+    if(crcs_new_.empty())
+      return true;
+    TRYMSG(save_table_(crc_name_(),crcs_new_,8,crcs_),crc_name_().c_str());
+    crcs_new_.clear();
+    if(stat(crc_name_().c_str(),&st)==0) // what's on disk is what's in crcs_
+    { crcs_loaded_=true;
+      crcs_mtime_=st.st_mtime;
+      crcs_size_=(uint64_t)st.st_size;
+    }
+    return true;
+Error:
+    return false;
+  }
+
+  /** Saves whichever sidecars are kept.  \returns true on success, otherwise false. */
+  bool save_sidecars()
+  { if(params.incremental)
+      TRY(save_hashes());
+    if(params.checksum && !params.pack)
+      TRY(save_crcs());
+    return true;
+Error:
+    return false;
+  }
+
+  /**
+   * For verify mode.  Starts checking the member file \a path against its
+   * recorded checksum on another thread, so it overlaps with decoding it.
+   * The check reads the file again, but right after it's been read for
+   * decoding, so that usually comes from the page cache.
+   * \returns the future result: false if the file doesn't match.  Files
+   *          without a checksum, or any file when not in verify mode, pass.
+   */
+  std::future<bool> check(const std::string& path)
+  { if(!params.verify)
+    { std::promise<bool> p;
+      p.set_value(true);
+      return p.get_future();
+    }
+    return std::async(std::launch::async,&series_t::verify_,this,path);
+  }
+
+  /**
+   * Sets \a sizes to the size in bytes of each of \a members, in order.
+   *
+   * The sizes are kept, with each member's mtime, in a sidecar next to the
+   * series, e.g. <tt>.vol.%.tif.ndio-series-sizes</tt>, so that several
+   * processes working on one series split it by the same record.  Each
+   * member is stat'ed; members that are new or whose mtime or size changed
+   * are updated, and members that are gone are dropped.  The sidecar is
+   * only rewritten when something changed.
+   *
+   * \returns true on success, otherwise false.
+   */
+  bool member_sizes(const TSeekTable& members, std::vector<uint64_t>& sizes)
+  { TStatTable known,now;
+    TStatTable::const_iterator k;
+    TSeekTable::const_iterator it;
+    bool changed;
+    sizes.clear();
+    if(pack_)
+    { for(it=members.begin();it!=members.end();++it)
+      { const pack_entry_t *e;
+        TRYMSG(e=pack_->find(it->second),it->second.c_str());
+        sizes.push_back(e->nbytes);
+      }
+      return true;
+    }
+    load_table_(sizes_name_(),known);
+    changed=known.size()!=members.size(); // e.g. members that are gone
+    for(it=members.begin();it!=members.end();++it)
+    { struct stat st;
+      member_stat_t m;
+      std::string f=path_.empty()?it->second:path_+PATHSEP+it->second;
+      TRYMSG(stat(f.c_str(),&st)==0,f.c_str());
+      m.size=st.st_size;
+      m.mtime=st.st_mtime;
+      changed|=(k=known.find(it->second))==known.end() || k->second!=m;
+      sizes.push_back(m.size);
+      now[it->second]=m;
+    }
+    if(changed)
+      save_table_(sizes_name_(),now,0,known,false); // fails in e.g. a read-only archive; just don't share
+    return true;
+Error:
+    return false;
+  }
+
+  private:
+    /** \returns the directory to list for member files. */
+    std::string dir_() const { return path_.empty()?".":path_; }
+
+    /**
+     * (watch mode) Applies pending inotify events to seektable_ and the
+     * extents.  Doesn't block.
+     * \returns true on success, otherwise false.
+     */
+    bool poll_watch_()
+    {
+#ifdef HAVE_INOTIFY
+      char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+      ssize_t n;
+      bool rebuild=false;
+      while((n=read(watch_,buf,sizeof(buf)))>0)
+      { for(char *p=buf;p<buf+n;)
+        { const struct inotify_event *e=(const struct inotify_event*)p;
+          TPos pos;
+          p+=sizeof(*e)+e->len;
+          if(e->mask&IN_Q_OVERFLOW)
+            rebuild=true;
+          if(!e->len || !parse(e->name,pos))
+            continue;
+          pending_.erase(e->name);
+          if(e->mask&(IN_CLOSE_WRITE|IN_MOVED_TO))
+            admit_(pos,e->name);
+          else if(e->mask&(IN_DELETE|IN_MOVED_FROM))
+          { seektable_.erase(pos);
+            rebuild=true; // extents may shrink.  Rare, so just recompute.
+          }
+        }
+      }
+      TRYMSG(n>=0 || errno==EAGAIN,strerror(errno));
+      if(rebuild)
+        TRY(build_seek_table_());
+      else if(!pending_.empty())     // no event for a file that was closed before the watch started
+      { TStatTable seen;
+        seen.swap(pending_);
+        for(TStatTable::const_iterator it=seen.begin();it!=seen.end();++it)
+        { TPos pos;
+          if(parse(it->first,pos) && settled_(it->first,seen))
+            admit_(pos,it->first);
+        }
+      }
+      return true;
+Error:
+#endif
+      return false;
+    }
+
+    /** \returns the filename part of \a name. */
+    static std::string basename_(const std::string& name)
+    { size_t n=name.rfind(PATHSEP[0]);
+      return (n==std::string::npos)?name:name.substr(n+1);
+    }
+
+    /**
+     * \returns the name of the file that holds the per-member content hashes
+     * for incremental writes.  It lives beside the member files and is named
+     * after the "%" form of the pattern, e.g. <tt>.vol.%.tif.ndio-series</tt>.
+     */
+    std::string sidecar_name_()
+    { return percent_name_(".",".ndio-series");
+    }
+
+    /** \returns the name of the checksum sidecar, e.g. <tt>.vol.%.tif.ndio-series-crc</tt>. */
+    std::string crc_name_()
+    { return percent_name_(".",".ndio-series-crc");
+    }
+
+    /** \returns the name of the member size sidecar.  See member_sizes(). */
+    std::string sizes_name_()
+    { return percent_name_(".",".ndio-series-sizes");
+    }
+
+    /**
+     * \returns the name of the series' pack file, named after the "%" form
+     * of the pattern, e.g. <tt>vol.%.tif.pack</tt>.
+     */
+    std::string pack_name_()
+    { return percent_name_("",".pack");
+    }
+
+    /** \returns \a prefix + the "%" form of the pattern + \a suffix, in the series' folder. */
+    std::string percent_name_(const char *prefix, const char *suffix)
+    { std::string out,t(parts_.empty()?pattern_:parts_[0]);
+      for(size_t i=0;i<widths_.size();++i)
+      { char buf[16]="%";
+        if(widths_[i])
+          snprintf(buf,countof(buf),"%%0%u",widths_[i]);
+        t+=buf;
+        t+=parts_[i+1];
+      }
+      if(!roots_.empty())
+      { out+=roots_[0];
+        out+=PATHSEP;
+      } else if(!path_.empty())
+      { out+=path_;
+        out+=PATHSEP;
+      }
+      out+=prefix;
+      out+=t;
+      out+=suffix;
+      return out;
+    }
+
+    /**
+     * Loads the content hashes from the sidecar file once.  A missing sidecar
+     * just means there's nothing to skip.
+     * \returns true on success, otherwise false.
+     */
+    bool load_hashes_()
+    { if(hashes_loaded_) return true;
+      hashes_loaded_=true;
+      load_table_(sidecar_name_(),hashes_);
+      return true;
+    }
+
+    /**
+     * Reads the checksum sidecar if it's changed since it was last read, so
+     * a reader sees checksums written since it opened the series.  Call
+     * with books_ held.
+     */
+    void refresh_crcs_()
+    { struct stat st;
+      if(stat(crc_name_().c_str(),&st)!=0)
+        return;                      // nothing recorded (yet)
+      if(crcs_loaded_ && st.st_mtime==crcs_mtime_ && (uint64_t)st.st_size==crcs_size_)
+        return;
+      load_table_(crc_name_(),crcs_);
+      for(THashTable::const_iterator it=crcs_new_.begin();it!=crcs_new_.end();++it)
+        crcs_[it->first]=it->second; // not saved yet, so newer than the sidecar
+      crcs_loaded_=true;
+      crcs_mtime_=st.st_mtime;
+      crcs_size_=(uint64_t)st.st_size;
+    }
+
+    /** Checks the member file \a path against its checksum.  See check(). */
+    bool verify_(std::string path)
+    { THashTable::const_iterator it;
+      uint64_t want;
+      uint32_t crc;
+      { std::lock_guard<std::mutex> g(books_);
+        refresh_crcs_();
+        if((it=crcs_.find(basename_(path)))==crcs_.end())
+          return true;
+        want=it->second;
+      }
+      TRYMSG(crc32c_file(path.c_str(),&crc),path.c_str());
+      TRYMSG(crc==want,"Checksum mismatch.  The member file is corrupt.");
+      return true;
+Error:
+      LOG("\t%s"ENDL,path.c_str());
+      ++nbad_;
+      return false;
+    }
+
+    /**
+     * Adds the entries of the sidecar \a name to \a table.  Each line is a
+     * value in hex and a file name.  A missing sidecar adds nothing.
+     */
+    template<typename T> static void load_table_(const std::string& name, std::map<TName,T>& table)
+    { FILE *fp;
+      char line[1024];
+      if(!(fp=fopen(name.c_str(),"r")))
+        return;
+      while(fgets(line,sizeof(line),fp))
+      { char *name=line;
+        size_t n;
+        T v;
+        if(!scan_value_(name,v) || *name!=' ') continue;
+        ++name;
+        n=strlen(name);
+        while(n && (name[n-1]=='\n' || name[n-1]=='\r'))
+          name[--n]='\0';
+        if(n) table[name]=v;
+      }
+      fclose(fp);
+    }
+
+    /** Reads a hex value at \a s and moves \a s past it.  \returns false if there isn't one. */
+    static bool scan_value_(char *&s, uint64_t& v)
+    { char *e;
+      v=strtoull(s,&e,16);
+      if(e==s) return false;
+      s=e;
+      return true;
+    }
+
+    /** Reads a member's size and mtime, in hex and separated by a space. */
+    static bool scan_value_(char *&s, member_stat_t& v)
+    { return scan_value_(s,v.size) && *s++==' ' && scan_value_(s,v.mtime);
+    }
+
+    static int print_value_(FILE *fp, int width, uint64_t v)
+    { return fprintf(fp,"%0*llx",width,(unsigned long long)v);
+    }
+
+    static int print_value_(FILE *fp, int width, const member_stat_t& v)
+    { return fprintf(fp,"%0*llx %0*llx",width,(unsigned long long)v.size,width,(unsigned long long)v.mtime);
+    }
+
+    /**
+     * Saves \a changes to the sidecar \a name, values as \a width hex
+     * digits, and sets \a table to what was saved.  When \a merge is set,
+     * the sidecar is read again and \a changes written over it, so entries
+     * other processes saved in the meantime are kept.  Otherwise \a changes
+     * replaces it.
+     *
+     * The sidecar is replaced atomically, through a temp file named for the
+     * process, so an interrupted write can't leave entries for files that
+     * weren't written and processes saving at once don't mix their files.
+     * Without \a changes, nothing is saved.
+     * \returns true on success, otherwise false.  Not being able to create
+     *          the temp file, e.g. in a read-only directory, isn't logged.
+     */
+    template<typename T>
+    static bool save_table_(const std::string& name, const std::map<TName,T>& changes, int width, std::map<TName,T>& table, bool merge=true)
+    { typedef typename std::map<TName,T>::const_iterator TIter;
+      FILE *fp=0;
+      char pid[32];
+      std::string tmp;
+      std::map<TName,T> all;
+      if(changes.empty())
+        return true;
+      snprintf(pid,sizeof(pid),".%d.tmp",(int)getpid());
+      tmp=name+pid;
+      if(merge)
+        load_table_(name,all);
+      for(TIter it=changes.begin();it!=changes.end();++it)
+        all[it->first]=it->second;
+      if(!(fp=fopen(tmp.c_str(),"w")))
+        return false;
+      for(TIter it=all.begin();it!=all.end();++it)
+        TRYMSG(print_value_(fp,width,it->second)>0 && fprintf(fp," %s\n",it->first.c_str())>0,strerror(errno));
+      TRYMSG(fclose(fp)==0,strerror(errno));
+      fp=0;
+#ifdef _MSC_VER
+      remove(name.c_str()); // rename() won't replace an existing file
+#endif
+      TRYMSG(rename(tmp.c_str(),name.c_str())==0,strerror(errno));
+      table.swap(all);
+      return true;
+Error:
+      if(fp) fclose(fp);
+      remove(tmp.c_str());
+      return false;
+    }
+
+    /**
+     * Makes the file name pattern from \a name, where each match of \a re
+     * is a field.  \a prefix is kept in front of each field.
+     *
+     * The group in \a re gives the field's width.  For an \a example name
+     * it's the number itself, and leading zeros mean it's padded to its
+     * length.  Otherwise it's an optional <tt>0N</tt>, as in <tt>%04</tt>.
+     *
+     * \returns true if a pattern is detected, otherwise false.
+     */
+    bool gen_pattern_(const std::string& name, const regex_t& re, const char* prefix, bool example)
+    { regmatch_t m[2];
+      const char *s=name.c_str();
+      std::string ptn;
+      parts_.assign(1,std::string());
+      widths_.clear();
+      while(tre_regexec(&re,s,2,m,0)==0 && m[0].rm_eo>0)
+      { unsigned w=0;
+        char field[64];
+        if(m[1].rm_so>=0)
+        { const std::string g(s+m[1].rm_so,m[1].rm_eo-m[1].rm_so);
+          if(example)
+            w=(g.size()>1 && g[0]=='0')?(unsigned)g.size():0;
+          else
+            w=(unsigned)atoi(g.c_str());
+        }
+        if(w) snprintf(field,countof(field),"([[:digit:]]{%u,})",w);
+        else  snprintf(field,countof(field),"([[:digit:]]+)");
+        parts_.back()+=std::string(s,m[0].rm_so)+prefix;
+        parts_.push_back(std::string());
+        widths_.push_back(w);
+        ptn+=std::string(s,m[0].rm_so)+prefix+field;
+        s+=m[0].rm_eo;
+      }
+      parts_.back()+=s;
+      ndim_=(unsigned)widths_.size();
+      if(ndim_) pattern_=ptn+s;
+      else      parts_.clear();
+      return ndim_>0;
+    }
+
+    /**
+     * Build seek table by searching through the \a path_ and locating parsable
+     * files.  The parsed positions are inserted into the \a seektable_.
+     *
+     * In watch mode a listed file might still be open for writing, so files
+     * that weren't indexed already are only admitted once settled_() says
+     * so.  The rest wait in pending_ for their IN_CLOSE_WRITE or to settle.
+     * \returns true on success, otherwise false.
+     */
+    bool build_seek_table_()
+    { TSeekTable all,old;
+      TStatTable seen;
+      TPos mn,mx;
+      if(!watching() || pack_)
+        return scan_(seektable_,mn_,mx_);
+      TRY(scan_(all,mn,mx));
+      old.swap(seektable_);
+      seen.swap(pending_);
+      mn_.clear();
+      mx_.clear();
+      for(TSeekTable::const_iterator it=all.begin();it!=all.end();++it)
+      { TSeekTable::const_iterator o=old.find(it->first);
+        if((o!=old.end() && o->second==it->second) || settled_(it->second,seen))
+          admit_(it->first,it->second);
+      }
+      return true;
+Error:
+      return false;
+    }
+
+    /** (watch mode) Indexes the member file \a name at \a pos. */
+    void admit_(const TPos& pos, const std::string& name)
+    { TPos p(pos);
+      seektable_[p]=name;
+      vmin(mn_,p);
+      vmax(mx_,p);
+    }
+
+    /**
+     * (watch mode) \returns true if the listed file \a name is done being
+     * written.  Where Linux allows a read lease on it, that's whether anyone
+     * still has it open for writing.  Otherwise the file has to be more than
+     * a second old and, if it's in \a seen, unchanged since.
+     *
+     * A file that isn't done is added to pending_ to be looked at again.
+     */
+    bool settled_(const std::string& name, const TStatTable& seen)
+    { struct stat st;
+      member_stat_t m;
+      TStatTable::const_iterator it;
+      bool busy=false;
+      const std::string f=path_.empty()?name:path_+PATHSEP+name;
+      if(stat(f.c_str(),&st)!=0)
+        return false;                 // gone; its IN_DELETE will follow
+      m.size=st.st_size;
+      m.mtime=st.st_mtime;
+#if defined(HAVE_INOTIFY) && defined(F_SETLEASE)
+      { int fd=open(f.c_str(),O_RDONLY|O_CLOEXEC|O_NONBLOCK),r=-1;
+        if(fd>=0)
+        { if((r=fcntl(fd,F_SETLEASE,F_RDLCK))==0)
+            fcntl(fd,F_SETLEASE,F_UNLCK);
+          else
+            busy=(errno==EAGAIN);     // open for writing.  Other errors mean no lease here.
+          close(fd);
+        }
+        if(r==0) return true;
+      }
+#endif
+      if(!busy && time(NULL)>st.st_mtime+1 && ((it=seen.find(name))==seen.end() || !(it->second!=m)))
+        return true;
+      pending_[name]=m;
+      return false;
+    }
+
+    /** Frees a partly written member's buffer and forgets it. */
+    void release_(TPartials::iterator it)
+    { if(it->second.a)
+      { partial_bytes_-=ndnbytes(it->second.a);
+        ndfree(it->second.a);
+      }
+      partial_.erase(it);
+    }
+
+    /**
+     * \returns the in-memory copy of the member at \a ipos, loading or
+     * creating it as needed, or NULL on error.
+     *
+     * Makes room first by writing out the least recently used members until
+     * the new one fits in ndio_series_params_t::write_budget.
+     */
+    partial_t* partial(const TPos& ipos, nd_type_id_t type, const TPos& shape, commit_t *commit)
+    { partial_t *p=&partial_[ipos];
+      nd_t a=0,s=0;
+      p->tick=++tick_;
+      if(p->a) return p;
+      TRY(a=ndinit());
+      TRY(ndreshape(ndcast(a,type),(unsigned)shape.size(),&shape[0]));
+      while(partial_bytes_+ndnbytes(a)>params.write_budget)
+      { TPartials::iterator it,lru=partial_.end();
+        for(it=partial_.begin();it!=partial_.end();++it)
+          if(it->second.a && (lru==partial_.end() || it->second.tick<lru->second.tick))
+            lru=it;
+        if(lru==partial_.end()) break; // always allow one
+        if(!put(lru->first,lru->second.a,commit) && commit)
+          goto Error;
+        partial_bytes_-=ndnbytes(lru->second.a);
+        ndfree(lru->second.a);
+        lru->second.a=0;
+      }
+      TRY(ndref(a,calloc(1,ndnbytes(a)),nd_heap));
+      { std::string name;                // patch the file on disk, if there is one
+        TPos t(ipos);
+        struct stat st;
+        TRY(makename(name,t));
+        if(stat(name.c_str(),&st)==0)
+        { ndio_t f=ndioOpen(name.c_str(),NULL,"r");
+          if(f && (s=ndioShape(f)) && ndtype(s)==type && ndndim(s)==shape.size()
+             && memcmp(ndshape(s),&shape[0],shape.size()*sizeof(size_t))==0)
+            ndioRead(f,a);
+          ndfree(s);
+          ndioClose(f);
+        }
+      }
+      p->a=a;
+      partial_bytes_+=ndnbytes(a);
+      return p;
+Error:
+      ndfree(a);
+      if(!p->filled) partial_.erase(ipos);
+      return 0;
+    }
+
+    /**
+     * Renumbers the positions in \a table densely along each field and sets
+     * the extents to match.  The original numbers are kept in labels_.
+     */
+    void compact_(TSeekTable& table, TPos& mn, TPos& mx)
+    { TSeekTable out;
+      TSeekTable::const_iterator it;
+      size_t i;
+      labels_.assign(ndim_,TPos());
+      for(it=table.begin();it!=table.end();++it)
+        for(i=0;i<ndim_ && i<it->first.size();++i)
+          labels_[i].push_back(it->first[i]);
+      for(i=0;i<ndim_;++i)
+      { std::sort(labels_[i].begin(),labels_[i].end());
+        labels_[i].erase(std::unique(labels_[i].begin(),labels_[i].end()),labels_[i].end());
+      }
+      for(it=table.begin();it!=table.end();++it)
+      { TPos p(it->first);
+        for(i=0;i<ndim_ && i<p.size();++i)
+          p[i]=std::lower_bound(labels_[i].begin(),labels_[i].end(),p[i])-labels_[i].begin();
+        out[p]=it->second;
+      }
+      table.swap(out);
+      if(table.empty()) return;       // leave the extents empty
+      mn.assign(ndim_,0);
+      mx.resize(ndim_);
+      for(i=0;i<ndim_;++i)
+        mx[i]=labels_[i].size()-1;
+    }
+
+    /**
+     * Lists \a path_ for parsable files, filling \a table and the extents
+     * \a mn and \a mx.
+     * \returns true on success, otherwise false.
+     */
+    bool scan_(TSeekTable& table, TPos& mn, TPos& mx)
+    { TListing listing;
+      table.clear();
+      mn.clear();
+      mx.clear();
+      if(pack_)                   // the pack's index stands in for the directory
+      { pack_t::TIndex::const_iterator it;
+        for(it=pack_->index().begin();it!=pack_->index().end();++it)
+        { TPos pos;
+          if(parse(it->first,pos))
+          { table[pos]=it->first;
+            vmin(mn,pos);
+            vmax(mx,pos);
+          }
+        }
+        return true;
+      }
+      TRY(list_(listing));
+      table=listing->table;
+      mn=listing->mn;
+      mx=listing->mx;
+      return true;
+Error:
+      return false;
+    }
+
+    /**
+     * Gets the listing of \a path_, shared with other handles on the same
+     * series.  The directory is only listed if it changed since the last
+     * listing.  See listing_cache_t.
+     * \returns true on success, otherwise false.
+     */
+    bool list_(TListing& out)
+    { if(roots_.empty())
+        return list_dir_(dir_(),out);
+      out=std::make_shared<listing_t>();  // merge the stripes' listings
+      for(size_t i=0;i<roots_.size();++i)
+      { TListing part;
+        std::map<TPos,std::string>::const_iterator it;
+        TRY(list_dir_(roots_[i],part));
+        for(it=part->table.begin();it!=part->table.end();++it)
+          out->table[it->first]=roots_[i]+PATHSEP+it->second;
+        if(!part->table.empty())
+        { vmin(out->mn,part->mn);
+          vmax(out->mx,part->mx);
+        }
+      }
+      return true;
+Error:
+      out.reset();
+      return false;
+    }
+
+    /** Lists the directory \a path.  See list_(). */
+    bool list_dir_(const std::string& path, TListing& out)
+    { DIR *dir=0;
+      struct dirent *ent;
+      struct stat st;
+      std::string key;
+      TRYMSG(stat(path.c_str(),&st)==0,strerror(errno)); // before listing, so a change while listing is seen next time
+      key=canonical(path)+PATHSEP+pattern_;
+      if((out=listings().get(key,st)))
+        return true;
+      out=std::make_shared<listing_t>();
+      out->mtime=st.st_mtime;
+      TRYMSG(dir=opendir(path.c_str()),strerror(errno));
+      while((ent=readdir(dir))!=NULL)
+      { TPos pos;
+        if(parse(ent->d_name,pos))
+        { out->table[pos]=ent->d_name;
+          vmin(out->mn,pos);
+          vmax(out->mx,pos);
+        }
+      }
+      closedir(dir);
+      out->racy=time(NULL)<=out->mtime+1;
+      listings().put(key,out);
+      return true;
+Error:
+      LOG("\t%s"ENDL,path.c_str());
+      out.reset();
+      return false;
+    }
+};
+
+//
+// === SLAB ITERATION ===
+//
+
+/**
+ * Reads a series one slab at a time for ndioSeriesSlabNext().
+ *
+ * Slab \a k lives in <tt>ring_[k%ring_.size()]</tt>.  A worker thread fills
+ * slabs in order, running at most <tt>ring_.size()</tt> slabs ahead of the
+ * consumer, so memory use is bounded by the ring size.
+ */
+struct slab_iter_t
+{ series_t            *series_;
+  series_t::TSeekTable members_;   ///< snapshot of the index
+  TPos                 mn_,        ///< position of the first member in each series dimension
+                       extent_,    ///< number of positions along each series dimension
+                       slab_,      ///< slab shape along the series dimensions
+                       grid_;      ///< number of slabs along each series dimension
+  std::vector<size_t>  fshape_;    ///< shape of a member file
+  nd_type_id_t         type_;      ///< pixel type of the member files
+  size_t               nslabs_,    ///< total number of slabs
+                       next_,      ///< next slab to hand to the consumer
+                       filled_,    ///< number of slabs filled by the worker
+                       released_;  ///< number of slabs released by the consumer
+  bool                 stop_,failed_;
+  std::vector<nd_t>    ring_;
+  std::mutex              lock_;
+  std::condition_variable cv_;
+  std::thread             worker_;
+  scratch_t               scratch_; ///< decoding space for the worker
+
+  slab_iter_t(series_t *series)
+  : series_(series)
+  , type_(nd_id_unknown)
+  , nslabs_(0),next_(0),filled_(0),released_(0)
+  , stop_(false),failed_(false)
+  {}
+
+  ~slab_iter_t()
+  { { std::unique_lock<std::mutex> g(lock_);
+      stop_=true;
+    }
+    cv_.notify_all();
+    if(worker_.joinable())
+      worker_.join();
+    for(size_t i=0;i<ring_.size();++i)
+      ndfree(ring_[i]);
+  }
+
+  /**
+   * Takes the index, allocates the ring and starts the worker.
+   * See ndioSeriesSlabBegin().
+   * \returns true on success, otherwise false.
+   */
+  bool start(const size_t *shape, size_t budget)
+  { TPos mx;
+    nd_t f=0;
+    size_t nbytes,nbuf;
+    const unsigned nd=series_->ndim_;
+    TRY(series_->index(members_,mn_,mx));
+    TRYMSG(!members_.empty(),"Could not find files that matched the file series pattern.");
+    TRY(f=series_->single_file_shape());
+    fshape_.assign(ndshape(f),ndshape(f)+ndndim(f));
+    type_=ndtype(f);
+    nbytes=ndnbytes(f);
+    ndfree(f); f=0;
+    TRY(series_->member_type(type_));
+    nslabs_=1;
+    for(unsigned i=0;i<nd;++i)
+    { extent_.push_back(mx[i]-mn_[i]+1);
+      slab_.push_back((shape && shape[i])?((shape[i]<extent_[i])?shape[i]:extent_[i]):extent_[i]);
+      grid_.push_back((extent_[i]+slab_[i]-1)/slab_[i]);
+      nslabs_*=grid_[i];
+      nbytes*=slab_[i];
+    }
+    nbuf=budget?budget/nbytes:2;
+    TRYMSG(nbuf>0,"The memory budget is smaller than one slab.");
+    nbuf=(nbuf<nslabs_)?nbuf:nslabs_;
+    for(size_t i=0;i<nbuf;++i)
+    { nd_t a;
+      TRY(a=ndinit());
+      ring_.push_back(a);
+      TRY(ndref(a,malloc(nbytes),nd_heap));
+      TRY(nddata(a));
+    }
+    worker_=std::thread(&slab_iter_t::work_,this);
+    return true;
+Error:
+    ndfree(f);
+    return false;
+  }
+
+  /**
+   * Waits for the next slab.  Releases the previous one back to the worker.
+   * \returns true if a slab was produced, otherwise false.
+   */
+  bool next(nd_t *slab, size_t *origin)
+  { TPos o;
+    if(next_>=nslabs_) return false;
+    { std::unique_lock<std::mutex> g(lock_);
+      released_=next_;
+      cv_.notify_all();
+      while(filled_<=next_ && !failed_)
+        cv_.wait(g);
+      if(filled_<=next_)
+        return false;
+    }
+    *slab=ring_[next_%ring_.size()];
+    if(origin)
+    { origin_(next_,o);
+      memset(origin,0,fshape_.size()*sizeof(size_t));
+      for(size_t i=0;i<o.size();++i)
+        origin[fshape_.size()+i]=o[i];
+    }
+    ++next_;
+    return true;
+  }
+
+private:
+  /** Position of slab \a k along the series dimensions. */
+  void origin_(size_t k, TPos& o)
+  { o.resize(grid_.size());
+    for(size_t i=0;i<grid_.size();++i)
+    { o[i]=(k%grid_[i])*slab_[i];
+      k/=grid_[i];
+    }
+  }
+
+  /** Worker thread: fills slabs in order, staying within the ring. */
+  void work_()
+  { for(size_t k=0;k<nslabs_;++k)
+    { bool ok;
+      { std::unique_lock<std::mutex> g(lock_);
+        while(!stop_ && k>=released_+ring_.size())
+          cv_.wait(g);
+        if(stop_) return;
+      }
+      ok=fill_(k,ring_[k%ring_.size()]);
+      { std::unique_lock<std::mutex> g(lock_);
+        if(ok) filled_=k+1;
+        else   failed_=true;
+      }
+      cv_.notify_all();
+      if(!ok) return;
+    }
+  }
+
+  /** Reads the members covered by slab \a k into \a a. */
+  bool fill_(size_t k, nd_t a)
+  { TPos o,shape(fshape_),p(grid_.size(),0);
+    const size_t fd=fshape_.size();
+    origin_(k,o);
+    for(size_t i=0;i<o.size();++i)
+      shape.push_back((o[i]+slab_[i]<=extent_[i])?slab_[i]:(extent_[i]-o[i]));
+    TRY(ndreshape(ndcast(a,type_),(unsigned)shape.size(),&shape[0]));
+    memset(nddata(a),0,ndnbytes(a));
+    if(series_->tuner_.ceiling()>1)
+      return fill_parallel_(o,shape,a);
+    do
+    { TPos key(p);
+      series_t::TSeekTable::const_iterator it;
+      vadd(key,o);
+      vadd(key,mn_);
+      if((it=members_.find(key))!=members_.end())
+      { bool ok;
+        for(size_t i=0;i<p.size();++i)
+          ndoffset(a,(unsigned)(fd+i),p[i]);
+        ok=series_->read_named(it->second,a,NULL,&scratch_);
+        for(size_t i=0;i<p.size();++i)
+          ndoffset(a,(unsigned)(fd+i),-(int64_t)p[i]);
+        TRY(ok);
+      }
+    } while(inc_(p,shape,fd));
+    return true;
+Error:
+    return false;
+  }
+
+  /**
+   * Like fill_(), but reads several members at once.  Each is scattered into
+   * its part of \a a, since \a a can't be offset for one thread at a time.
+   */
+  bool fill_parallel_(TPos& o, const TPos& shape, nd_t a)
+  { std::vector<unsigned> fds;
+    std::vector<TPos> at;
+    std::vector<const std::string*> names;
+    TPos p(grid_.size(),0);
+    const size_t fd=fshape_.size();
+    for(size_t i=0;i<p.size();++i)
+      fds.push_back((unsigned)(fd+i));
+    do
+    { TPos key(p);
+      series_t::TSeekTable::const_iterator it;
+      vadd(key,o);
+      vadd(key,mn_);
+      if((it=members_.find(key))!=members_.end())
+      { at.push_back(p);
+        names.push_back(&it->second);
+      }
+    } while(inc_(p,shape,fd));
+    return series_->run(at.size(),series_t::member_bytes(a,fds),[&](size_t i,scratch_t *scratch)
+    { return series_->scatter(*names[i],a,fds,&at[i][0],scratch);
+    })==0;
+  }
+
+  /** Increments \a p within the series dimensions of \a shape, first dimension fastest. */
+  static bool inc_(TPos& p, const TPos& shape, size_t fd)
+  { for(size_t i=0;i<p.size();++i)
+    { if(++p[i]<shape[fd+i]) return true;
+      p[i]=0;
+    }
+    return false;
+  }
+};
+
+void series_t::end_slabs()
+{ delete iter_;
+  iter_=0;
+}
+
+//
+// === DEMAND PAGING ===
+//
+
+#ifdef HAVE_USERFAULTFD
+/**
+ * A read-only view of the whole series that's filled in as it's touched.
+ *
+ * The array is a reserved range of address space registered with
+ * userfaultfd.  The first touch of a chunk faults and the handler thread
+ * copies in the members that overlap it.  At most \c nchunks_ chunks are
+ * resident.  Past that the oldest chunk is dropped with MADV_DONTNEED, so
+ * touching it again faults again.  Only faults are visible here, not
+ * accesses, so eviction is first in, first out.
+ *
+ * The last decoded member is kept, so a member that spans several chunks is
+ * only decoded once while they're filled in order.
+ */
+struct vmap_t
+{ series_t            *series_;
+  series_t::TSeekTable members_;   ///< snapshot of the index
+  TPos                 mn_,        ///< position of the first member in each series dimension
+                       extent_;    ///< number of positions along each series dimension
+  std::vector<size_t>  fshape_;    ///< shape of a member file
+  nd_type_id_t         type_;      ///< pixel type of the member files
+  size_t               mbytes_,    ///< bytes in a member
+                       nbytes_,    ///< bytes in the array
+                       chunk_,     ///< bytes filled per fault, a multiple of the page size
+                       nchunks_,   ///< most chunks resident at once
+                       len_;       ///< bytes mapped, nbytes_ rounded up to a chunk
+  char                *base_;      ///< the mapping
+  int                  uffd_,      ///< userfaultfd descriptor
+                       stop_;      ///< eventfd that stops the handler
+  nd_t                 array_,     ///< the view handed out, over base_
+                       member_;    ///< the last decoded member
+  size_t               imember_;   ///< which member is in member_
+  bool                 hasmember_; ///< member_ holds member imember_
+  char                *bounce_;    ///< a chunk being assembled
+  std::deque<size_t>   resident_;  ///< resident chunks, oldest first
+  std::set<size_t>     isresident_;
+  std::thread          handler_;
+  scratch_t            scratch_;   ///< decoding space for the handler
+
+  vmap_t(series_t *series)
+  : series_(series)
+  , type_(nd_id_unknown)
+  , mbytes_(0),nbytes_(0),chunk_(0),nchunks_(0),len_(0)
+  , base_(0)
+  , uffd_(-1),stop_(-1)
+  , array_(0),member_(0)
+  , imember_(0),hasmember_(false)
+  , bounce_(0)
+  {}
+
+  ~vmap_t()
+  { if(handler_.joinable())
+    { uint64_t one=1;
+      if(write(stop_,&one,sizeof(one))==sizeof(one))
+        handler_.join();
+      else
+        handler_.detach();
+    }
+    if(base_)     munmap(base_,len_);
+    if(uffd_>=0)  close(uffd_);
+    if(stop_>=0)  close(stop_);
+    ndfree(array_);
+    ndfree(member_);
+    free(bounce_);
+  }
+
+  /**
+   * Takes the index, reserves the address range and starts the handler.
+   * See ndioSeriesMap().
+   * \returns true on success, otherwise false.
+   */
+  bool start(size_t budget)
+  { TPos mx,shape;
+    nd_t f=0;
+    struct uffdio_api api;
+    struct uffdio_register reg;
+    const size_t page=(size_t)sysconf(_SC_PAGESIZE);
+    TRY(series_->index(members_,mn_,mx));
+    TRYMSG(!members_.empty(),"Could not find files that matched the file series pattern.");
+    TRY(f=series_->single_file_shape());
+    fshape_.assign(ndshape(f),ndshape(f)+ndndim(f));
+    type_=ndtype(f);
+    nbytes_=mbytes_=ndnbytes(f);
+    ndfree(f); f=0;
+    TRY(series_->member_type(type_));
+    shape=fshape_;
+    for(size_t i=0;i<mn_.size();++i)
+    { extent_.push_back(mx[i]-mn_[i]+1);
+      shape.push_back(extent_[i]);
+      nbytes_*=extent_[i];
+    }
+    if(!budget)
+      budget=2*mbytes_;
+    chunk_=(mbytes_<budget/8)?mbytes_:budget/8;   // at least 8 chunks resident
+    chunk_=((chunk_+page-1)/page)*page;
+    chunk_=chunk_?chunk_:page;
+    nchunks_=budget/chunk_;
+    nchunks_=nchunks_?nchunks_:1;
+    len_=((nbytes_+chunk_-1)/chunk_)*chunk_;
+
+    base_=(char*)mmap(NULL,len_,PROT_READ,MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE,-1,0);
+    if(base_==MAP_FAILED)
+    { base_=0;
+      FAIL(strerror(errno));
+    }
+    uffd_=(int)syscall(SYS_userfaultfd,O_CLOEXEC|O_NONBLOCK|UFFD_USER_MODE_ONLY);
+    if(uffd_<0 && errno==EINVAL) // kernels before 5.11 don't know the flag
+      uffd_=(int)syscall(SYS_userfaultfd,O_CLOEXEC|O_NONBLOCK);
+    TRYMSG(uffd_>=0,strerror(errno));
+    memset(&api,0,sizeof(api));
+    api.api=UFFD_API;
+    TRYMSG(ioctl(uffd_,UFFDIO_API,&api)==0,strerror(errno));
+    memset(&reg,0,sizeof(reg));
+    reg.range.start=(uintptr_t)base_;
+    reg.range.len=len_;
+    reg.mode=UFFDIO_REGISTER_MODE_MISSING;
+    TRYMSG(ioctl(uffd_,UFFDIO_REGISTER,&reg)==0,strerror(errno));
+    TRYMSG((stop_=eventfd(0,EFD_CLOEXEC))>=0,strerror(errno));
+
+    TRYMSG(posix_memalign((void**)&bounce_,page,chunk_)==0,"Out of memory.");
+    TRY(member_=ndinit());
+    TRY(ndref(member_,malloc(mbytes_),nd_heap));
+    TRY(nddata(member_));
+    TRY(ndreshape(ndcast(member_,type_),(unsigned)fshape_.size(),&fshape_[0]));
+    TRY(array_=ndinit());
+    TRY(ndref(array_,base_,nd_static));
+    TRY(ndreshape(ndcast(array_,type_),(unsigned)shape.size(),&shape[0]));
+    handler_=std::thread(&vmap_t::handle_,this);
+    return true;
+Error:
+    ndfree(f);
+    return false;
+  }
+
+private:
+  /** Handler thread: serves faults until stop_ is signalled. */
+  void handle_()
+  { struct pollfd p[2]={{uffd_,POLLIN,0},{stop_,POLLIN,0}};
+    for(;;)
+    { struct uffd_msg msg;
+      if(poll(p,2,-1)<0)
+      { if(errno==EINTR) continue;
+        return;
+      }
+      if(p[1].revents)
+        return;
+      if(read(uffd_,&msg,sizeof(msg))!=sizeof(msg)) // EAGAIN: someone else's fault was resolved
+        continue;
+      if(msg.event==UFFD_EVENT_PAGEFAULT)
+        fault_((size_t)(msg.arg.pagefault.address-(uintptr_t)base_)/chunk_);
+    }
+  }
+
+  /** Makes chunk \a c resident and wakes the threads waiting on it. */
+  void fault_(size_t c)
+  { struct uffdio_copy cp;
+    if(isresident_.count(c))      // several threads faulted on the same chunk
+    { wake_(c);
+      return;
+    }
+    fill_(c);
+    memset(&cp,0,sizeof(cp));
+    cp.dst=(uintptr_t)(base_+c*chunk_);
+    cp.src=(uintptr_t)bounce_;
+    cp.len=chunk_;
+    while(ioctl(uffd_,UFFDIO_COPY,&cp)!=0)
+    { if(errno==EAGAIN && cp.copy>0) // partial copy; carry on from there
+      { cp.dst+=cp.copy;
+        cp.src+=cp.copy;
+        cp.len-=cp.copy;
+        cp.copy=0;
+        continue;
+      }
+      if(errno==EEXIST)
+        wake_(c);
+      else
+        LOG("%s(%d): %s()"ENDL "\tCould not fill in the mapped series."ENDL "\t%s"ENDL,
+            __FILE__,__LINE__,__FUNCTION__,strerror(errno));
+      return;
+    }
+    resident_.push_back(c);
+    isresident_.insert(c);
+    if(resident_.size()>nchunks_)
+    { size_t old=resident_.front();
+      madvise(base_+old*chunk_,chunk_,MADV_DONTNEED); // next touch faults again
+      resident_.pop_front();
+      isresident_.erase(old);
+    }
+  }
+
+  void wake_(size_t c)
+  { struct uffdio_range r;
+    r.start=(uintptr_t)(base_+c*chunk_);
+    r.len=chunk_;
+    ioctl(uffd_,UFFDIO_WAKE,&r);
+  }
+
+  /** Assembles chunk \a c in bounce_.  Missing members and bytes past the end are zero. */
+  void fill_(size_t c)
+  { size_t off=c*chunk_,
+           end=(off+chunk_<nbytes_)?(off+chunk_):nbytes_;
+    memset(bounce_,0,chunk_);
+    while(off<end)
+    { const size_t k=off/mbytes_,
+                   at=off%mbytes_,
+                   n=(mbytes_-at<end-off)?(mbytes_-at):(end-off);
+      if(load_(k))
+        memcpy(bounce_+(off-c*chunk_),(char*)nddata(member_)+at,n);
+      off+=n;
+    }
+  }
+
+  /** Decodes member \a k into member_.  \returns false if it's missing or couldn't be read. */
+  bool load_(size_t k)
+  { TPos key(mn_);
+    series_t::TSeekTable::const_iterator it;
+    if(hasmember_ && imember_==k)
+      return true;
+    hasmember_=false;
+    imember_=k;
+    for(size_t i=0;i<extent_.size();++i)
+    { key[i]+=k%extent_[i];
+      k/=extent_[i];
+    }
+    if((it=members_.find(key))==members_.end())
+      return false;
+    TRY(series_->read_named(it->second,member_,NULL,&scratch_));
+    return hasmember_=true;
+Error:
+    return false;
+  }
+};
+#else
+struct vmap_t {};
+#endif
+
+void series_t::end_map()
+{ delete vmap_;
+  vmap_=0;
+}
+
+//
+// === FOCUSED LOADING ===
+//
+
+/**
+ * Loads a whole series into a caller's array in the background, nearest
+ * the focus first.  See ndioSeriesLoadBegin().
+ *
+ * Pending members are kept sorted farthest first, so workers take the
+ * nearest from the back.  Moving the focus re-sorts what's still pending.
+ */
+struct loader_t
+{ typedef std::pair<TPos,std::string> TItem; ///< position, relative to mn_, and file name
+  enum { pending, loading, done, failed };
+
+  series_t              *series_;
+  nd_t                   dst_;
+  std::vector<unsigned>  fd_;      ///< dimension of dst_ for each file name field
+  TPos                   mn_,      ///< position of the first member in each series dimension
+                         focus_;
+  std::vector<TItem>     queue_;   ///< pending members, farthest from focus_ first
+  std::map<TPos,int>     state_;   ///< every member's state, by position
+  size_t                 busy_,    ///< members being loaded
+                         nfailed_,
+                         bytes_;   ///< size of one member, for the tuner
+  bool                   stop_;
+  std::mutex              lock_;
+  std::condition_variable cv_;
+  std::vector<std::thread> workers_;
+
+  loader_t(series_t *series)
+  : series_(series),dst_(0),busy_(0),nfailed_(0),bytes_(0),stop_(false) {}
+
+  ~loader_t() { cancel(); }
+
+  /**
+   * Takes the index, orders it around \a focus and starts the workers.
+   * The series' tuner decides how many load at once.
+   * \returns true on success, otherwise false.
+   */
+  bool start(nd_t dst, const size_t *focus)
+  { series_t::TSeekTable members;
+    series_t::TSeekTable::const_iterator it;
+    TPos mx;
+    dst_=dst;
+    TRY(series_->field_dims(fd_,ndndim(dst)));
+    TRY(series_->index(members,mn_,mx));
+    TRYMSG(!members.empty(),"Could not find files that matched the file series pattern.");
+    for(it=members.begin();it!=members.end();++it)
+    { TPos p(it->first);
+      for(size_t i=0;i<p.size();++i)
+        p[i]-=mn_[i];
+      queue_.push_back(TItem(p,it->second));
+      state_[p]=pending;
+    }
+    set_focus_(focus);
+    bytes_=series_t::member_bytes(dst,fd_);
+    TRY(series_->member_type());
+    for(size_t i=(std::min)((size_t)series_->tuner_.ceiling(),queue_.size());i>0;--i)
+      workers_.push_back(std::thread(&loader_t::work_,this));
+    return true;
+Error:
+    return false;
+  }
+
+  /** Re-orders the pending members around \a focus. */
+  void focus(const size_t *focus)
+  { std::lock_guard<std::mutex> g(lock_);
+    set_focus_(focus);
+  }
+
+  /**
+   * Waits for the member at \a pos, or for everything if \a pos is NULL.
+   * \returns true if it was loaded, false if it failed, was cancelled,
+   *          doesn't exist, or the wait timed out.
+   */
+  bool wait(const size_t *pos, int timeout_ms)
+  { std::unique_lock<std::mutex> g(lock_);
+    std::chrono::steady_clock::time_point deadline=
+      std::chrono::steady_clock::now()+std::chrono::milliseconds(timeout_ms);
+    std::map<TPos,int>::const_iterator it=state_.end();
+    if(pos)
+    { TPos p(pos,pos+mn_.size());
+      if((it=state_.find(p))==state_.end())
+        return false;
+    }
+    for(;;)
+    { if(it!=state_.end()?(it->second==done || it->second==failed):(queue_.empty() && !busy_))
+        break;
+      if(stop_)
+        return false;
+      if(timeout_ms<0)
+        cv_.wait(g);
+      else if(cv_.wait_until(g,deadline)==std::cv_status::timeout)
+        return false;
+    }
+    return (it!=state_.end())?(it->second==done):(nfailed_==0);
+  }
+
+  /** Drops the pending members and waits for the ones being loaded. */
+  void cancel()
+  { { std::lock_guard<std::mutex> g(lock_);
+      stop_=true;
+      queue_.clear();
+    }
+    cv_.notify_all();
+    for(size_t i=0;i<workers_.size();++i)
+      if(workers_[i].joinable())
+        workers_[i].join();
+  }
+
+private:
+  /** Squared distance of \a p from focus_. */
+  uint64_t distance_(const TPos& p) const
+  { uint64_t d2=0;
+    for(size_t i=0;i<p.size();++i)
+    { uint64_t d=(p[i]>focus_[i])?(p[i]-focus_[i]):(focus_[i]-p[i]);
+      d2+=d*d;
+    }
+    return d2;
+  }
+
+  struct farther_
+  { const loader_t *self;
+    bool operator()(const TItem& a, const TItem& b) const
+    { uint64_t da=self->distance_(a.first),db=self->distance_(b.first);
+      return (da!=db)?(da>db):(a.first>b.first);
+    }
+  };
+
+  void set_focus_(const size_t *focus)
+  { farther_ cmp={this};
+    if(focus) focus_.assign(focus,focus+mn_.size());
+    else      focus_.assign(mn_.size(),0);
+    std::sort(queue_.begin(),queue_.end(),cmp);
+  }
+
+  /** Worker thread: loads the nearest pending member until there are none. */
+  void work_()
+  { scratch_t scratch;
+    for(;;)
+    { TItem item;
+      bool ok;
+      series_->tuner_.acquire();     // before choosing, so the choice sees the latest focus
+      { std::lock_guard<std::mutex> g(lock_);
+        if(stop_ || queue_.empty())
+        { series_->tuner_.abandon();
+          return;
+        }
+        item=queue_.back();
+        queue_.pop_back();
+        state_[item.first]=loading;
+        ++busy_;
+      }
+      ok=series_->scatter(item.second,dst_,fd_,&item.first[0],&scratch);
+      series_->tuner_.release(bytes_);
+      { std::lock_guard<std::mutex> g(lock_);
+        state_[item.first]=ok?done:failed;
+        nfailed_+=!ok;
+        --busy_;
+      }
+      cv_.notify_all();
+    }
+  }
+};
+
+void series_t::end_load()
+{ delete loader_;
+  loader_=0;
+}
+
+//
+// === ASYNC WRITES ===
+//
+
+static unsigned write_now(series_t *self, nd_t src);
+
+/**
+ * Writes arrays on a background thread for async mode.
+ *
+ * push() copies the caller's array onto a queue and returns, so the caller
+ * can get on with computing the next one while this one is encoded.  The
+ * queue holds at most ndio_series_params_t::queue_budget bytes, counting the
+ * array being written; push() blocks until there's room.
+ */
+struct writer_t
+{ series_t               *series_;
+  std::deque<nd_t>        queue_;
+  size_t                  bytes_;   ///< bytes queued or being written
+  unsigned                nfailed_; ///< number of arrays that failed to write since the last take_failures()
+  bool                    stop_,busy_;
+  std::mutex              lock_;
+  std::condition_variable cv_;
+  std::thread             worker_;
+
+  writer_t(series_t *series)
+  : series_(series)
+  , bytes_(0)
+  , nfailed_(0)
+  , stop_(false),busy_(false)
+  { worker_=std::thread(&writer_t::run_,this);
+  }
+
+  ~writer_t()
+  { drain();
+    { std::unique_lock<std::mutex> g(lock_);
+      stop_=true;
+    }
+    cv_.notify_all();
+    if(worker_.joinable())
+      worker_.join();
+  }
+
+  /**
+   * Queues a copy of \a src to be written.
+   * \returns true on success, otherwise false.
+   */
+  bool push(nd_t src)
+  { nd_t a=0;
+    size_t nb;
+    TRY(a=ndinit());
+    TRY(ndreshape(ndcast(a,ndtype(src)),ndndim(src),ndshape(src)));
+    nb=ndnbytes(a);
+    { std::unique_lock<std::mutex> g(lock_);
+      while(bytes_ && bytes_+nb>series_->params.queue_budget) // always let one through
+        cv_.wait(g);
+      bytes_+=nb;                    // reserve before copying
+    }
+    if(!ndref(a,malloc(nb),nd_heap) || !nddata(a)
+       || !xfer(nddata(a),ndstrides(a),ndtype(a),nddata(src),ndstrides(src),ndtype(src),
+                ndndim(src),ndshape(src),NULL))
+    { { std::unique_lock<std::mutex> g(lock_);
+        bytes_-=nb;
+      }
+      cv_.notify_all();
+      FAIL("Could not copy the array for writing.");
+    }
+    { std::unique_lock<std::mutex> g(lock_);
+      queue_.push_back(a);
+    }
+    cv_.notify_all();
+    return true;
+Error:
+    ndfree(a);
+    return false;
+  }
+
+  /** Waits until everything queued has been written. */
+  void drain()
+  { std::unique_lock<std::mutex> g(lock_);
+    while(!queue_.empty() || busy_)
+      cv_.wait(g);
+  }
+
+  /** \returns the number of arrays that failed to write since the last call. */
+  unsigned take_failures()
+  { std::unique_lock<std::mutex> g(lock_);
+    unsigned n=nfailed_;
+    nfailed_=0;
+    return n;
+  }
+
+private:
+  void run_()
+  { std::unique_lock<std::mutex> g(lock_);
+    while(1)
+    { nd_t a;
+      unsigned ok;
+      while(queue_.empty() && !stop_)
+        cv_.wait(g);
+      if(queue_.empty()) return;     // stopping
+      a=queue_.front();
+      queue_.pop_front();
+      busy_=true;
+      g.unlock();
+      ok=write_now(series_,a);
+      g.lock();
+      bytes_-=ndnbytes(a);
+      busy_=false;
+      if(!ok) ++nfailed_;
+      ndfree(a);
+      cv_.notify_all();
+    }
+  }
+};
+
+bool series_t::start_writer()
+{ if(!writer_)
+    writer_=new writer_t(this);
+  return writer_!=0;
+}
+
+bool series_t::stop_writer()
+{ unsigned n=0;
+  if(writer_)
+  { writer_->drain();
+    n=writer_->take_failures();
+  }
+  delete writer_;
+  writer_=0;
+  return n==0;
+}
+
+void series_t::drain()
+{ if(writer_)
+    writer_->drain();
+}
+
+/** See ndioSeriesSlabBegin(). */
+static unsigned series_slab_begin(ndio_t file, const size_t *shape, size_t budget)
+{ series_t *self=(series_t*)ndioContext(file);
+  self->end_slabs();
+  TRY(self->isr_);
+  self->drain();
+  TRYMSG(self->params.dims[0]<0,"Slabs don't support remapped series dimensions.");
+  TRY(self->iter_=new slab_iter_t(self));
+  TRY(self->iter_->start(shape,budget));
+  return 1;
+Error:
+  self->end_slabs();
+  return 0;
+}
+
+/** See ndioSeriesSlabNext(). */
+static unsigned series_slab_next(ndio_t file, nd_t *slab, size_t *origin)
+{ series_t *self=(series_t*)ndioContext(file);
+  TRYMSG(self->iter_,"Call ndioSeriesSlabBegin() first.");
+  TRYMSG(slab,"slab must not be NULL.");
+  return self->iter_->next(slab,origin);
+Error:
+  return 0;
+}
+
+/** See ndioSeriesSlabEnd(). */
+static void series_slab_end(ndio_t file)
+{ series_t *self=(series_t*)ndioContext(file);
+  self->end_slabs();
+}
+
+/** See ndioSeriesWriteSubarray(). */
+static unsigned series_write_subarray(ndio_t file, nd_t src, const size_t *origin, const size_t *shape)
+{ series_t *self=(series_t*)ndioContext(file);
+  commit_t *commit=0;
+  TRY(self->isw_);
+  TRYMSG(src && origin && shape,"Arguments must not be NULL.");
+  self->drain();                     // keep writes in order
+  if(self->params.durable)
+    commit=new commit_t(self->params.batch);
+  TRY(self->patch(src,origin,shape,commit));
+  if(commit)
+  { TRY(commit->commit());
+    delete commit;
+    commit=0;
+  }
+  TRY(self->save_sidecars());
+  return 1;
+Error:
+  if(commit) delete commit;
+  return 0;
+}
+
+/** See ndioSeriesFlush(). */
+static unsigned series_flush(ndio_t file)
+{ series_t *self=(series_t*)ndioContext(file);
+  commit_t *commit=0;
+  unsigned nfailed=0;
+  self->drain();
+  if(self->writer_)
+    nfailed=self->writer_->take_failures();
+  if(self->params.durable)
+    commit=new commit_t(self->params.batch);
+  TRY(self->flush_partial(commit));
+  if(commit)
+  { TRY(commit->commit());
+    delete commit;
+    commit=0;
+  }
+  TRY(self->save_sidecars());
+  if(self->packer_)
+    TRYMSG(self->packer_->finish(),strerror(errno));
+  if(!self->failed_.empty())
+  { LOG("%s(%d): %s()"ENDL "\tCould not write %u member file(s):"ENDL,
+        __FILE__,__LINE__,__FUNCTION__,(unsigned)self->failed_.size());
+    for(size_t i=0;i<self->failed_.size();++i)
+      LOG("\t\t%s"ENDL,self->failed_[i].c_str());
+    self->failed_.clear();
+    return 0;
+  }
+  TRYMSG(nfailed==0,"A queued write failed.");
+  return 1;
+Error:
+  if(commit) delete commit;
+  self->failed_.clear();
+  return 0;
+}
+
+/** See ndioSeriesLabels(). */
+static const size_t* series_labels(ndio_t file, unsigned ifield, size_t *n)
+{ series_t *self=(series_t*)ndioContext(file);
+  return self->field_labels(ifield,n);
+}
+
+/** See ndioSeriesMap(). */
+static nd_t series_map(ndio_t file, size_t budget)
+{ series_t *self=(series_t*)ndioContext(file);
+  self->end_map();
+  TRY(self->isr_);
+  self->drain();
+  TRYMSG(self->params.dims[0]<0,"Maps don't support remapped series dimensions.");
+#ifdef HAVE_USERFAULTFD
+  TRY(self->vmap_=new vmap_t(self));
+  TRY(self->vmap_->start(budget));
+  return self->vmap_->array_;
+#else
+  FAIL("Mapping a series needs userfaultfd, which is Linux only.");
+#endif
+Error:
+  self->end_map();
+  return 0;
+}
+
+/** See ndioSeriesCacheBudget(). */
+static void series_cache_budget(ndio_t, size_t bytes)
+{ tiles().set_budget(bytes);
+}
+
+/** See ndioSeriesCacheStats(). */
+static void series_cache_stats(ndio_t, ndio_series_cache_stats_t *stats)
+{ tiles().stats(stats);
+}
+
+/** See ndioSeriesUnmap(). */
+static void series_unmap(ndio_t file)
+{ series_t *self=(series_t*)ndioContext(file);
+  self->end_map();
+}
+
+/** See ndioSeriesLoadBegin(). */
+static unsigned series_load_begin(ndio_t file, nd_t dst, const size_t *focus)
+{ series_t *self=(series_t*)ndioContext(file);
+  self->end_load();
+  TRY(self->isr_);
+  self->drain();
+  TRY(self->loader_=new loader_t(self));
+  TRY(self->loader_->start(dst,focus));
+  return 1;
+Error:
+  self->end_load();
+  return 0;
+}
+
+/** See ndioSeriesLoadFocus(). */
+static unsigned series_load_focus(ndio_t file, const size_t *focus)
+{ series_t *self=(series_t*)ndioContext(file);
+  TRY(self->loader_);
+  self->loader_->focus(focus);
+  return 1;
+Error:
+  return 0;
+}
+
+/** See ndioSeriesLoadWait(). */
+static unsigned series_load_wait(ndio_t file, const size_t *pos, int timeout_ms)
+{ series_t *self=(series_t*)ndioContext(file);
+  return self->loader_ && self->loader_->wait(pos,timeout_ms);
+}
+
+/** See ndioSeriesConcurrency(). */
+static unsigned series_concurrency(ndio_t file)
+{ series_t *self=(series_t*)ndioContext(file);
+  return self->tuner_.width();
+}
+
+static nd_t series_shape(ndio_t file);
+
+/** See ndioSeriesPartition(). */
+static unsigned series_partition(ndio_t file, unsigned rank, unsigned nworkers, size_t *origin, size_t *shape)
+{ series_t *self=(series_t*)ndioContext(file);
+  series_t::TSeekTable members;
+  series_t::TSeekTable::const_iterator it;
+  std::vector<uint64_t> sizes,cum;
+  std::vector<unsigned> fd;
+  TPos mn,mx;
+  nd_t s=0;
+  uint64_t total;
+  size_t i,d,bounds[2];
+  TRYMSG(nworkers>0 && rank<nworkers,"The rank must be less than the number of workers.");
+  TRY(self->isr_);
+  self->drain();
+  TRY(self->index(members,mn,mx));
+  TRYMSG(!members.empty(),"Could not find files that matched the file series pattern.");
+  TRY(self->member_sizes(members,sizes));
+  TRY(s=series_shape(file));
+  TRY(self->field_dims(fd,ndndim(s)));
+  d=fd.back();                       // split along the last file name field, as slabs do
+  cum.assign(mx.back()-mn.back()+2,0);
+  for(it=members.begin(),i=0;it!=members.end();++it,++i)
+    cum[it->first.back()-mn.back()+1]+=sizes[i];
+  for(i=1;i<cum.size();++i)
+    cum[i]+=cum[i-1];
+  total=cum.back();
+  for(unsigned k=0;k<2;++k)          // each boundary goes where the running total is nearest its share
+  { uint64_t r=rank+k,
+             target=(total/nworkers)*r+((total%nworkers)*r)/nworkers;
+    size_t j=std::lower_bound(cum.begin(),cum.end(),target)-cum.begin();
+    if(j>0 && target-cum[j-1]<cum[j]-target)
+      --j;
+    bounds[k]=(r==nworkers)?cum.size()-1:j;
+  }
+  for(i=0;i<ndndim(s);++i)
+  { origin[i]=0;
+    shape[i]=ndshape(s)[i];
+  }
+  origin[d]=bounds[0];
+  shape[d]=bounds[1]-bounds[0];
+  ndfree(s);
+  return 1;
+Error:
+  ndfree(s);
+  return 0;
+}
+
+/** See ndioSeriesStats(). */
+static const ndio_series_stats_t* series_stats(ndio_t file, ndio_series_stats_t *all, size_t *hist, size_t *nplanes)
+{ series_t *self=(series_t*)ndioContext(file);
+  if(nplanes) *nplanes=self->planes_.size();
+  if(self->planes_.empty())
+    return 0;
+  if(all)
+  { all->min=self->total_.min;
+    all->max=self->total_.max;
+    all->mean=self->total_.n?self->total_.sum/self->total_.n:0.0;
+    all->count=self->total_.n;
+  }
+  if(hist)
+    memcpy(hist,self->hist_,sizeof(self->hist_));
+  return &self->planes_[0];
+}
+
+/** See ndioSeriesProgress(). */
+static void series_progress(ndio_t file, ndio_series_progress_fn fn, void *user)
+{ series_t *self=(series_t*)ndioContext(file);
+  self->drain();                     // the writer might be calling the old one
+  self->progress_fn_=fn;
+  self->progress_user_=user;
+}
+
+/** See ndioSeriesFieldCount(). */
+static unsigned series_field_count(ndio_t file)
+{ series_t *self=(series_t*)ndioContext(file);
+  return (unsigned)self->ndim_;
+}
+
+/** See ndioSeriesLoadCancel(). */
+static void series_load_cancel(ndio_t file)
+{ series_t *self=(series_t*)ndioContext(file);
+  self->end_load();
+}
 
 /** The format name.
     Use the format name to select this format.
@@ -515,6 +3791,22 @@ static unsigned series_is_fmt(const char* path, const char *mode)
  *              <tt>12310002353111351345.mp4</tt> with a position of
  *              <tt>(...,0,111)</tt>.
  *
+ *    A field may give a zero-padded width, as in printf():
+ *
+ *     Example: <tt>myfile.%04.tif</tt> would find/write files like
+ *              <tt>myfile.0003.tif</tt>.
+ *
+ *    A field without a width finds numbers padded or not, so
+ *    <tt>myfile.%.tif</tt> finds <tt>myfile.0003.tif</tt> too.  Series
+ *    that share a folder need different prefixes, or one also lists the
+ *    other's files.
+ *
+ * Widths are inferred from an example name too: a number with leading
+ * zeros is padded to its length, so <tt>myfile.0.0003.tif</tt> is the same
+ * as <tt>myfile.%.%04.tif</tt>.  When every field has a width, sub-array
+ * reads make the member's file name from the position instead of listing
+ * the directory for it.
+ *
  * The number of dimensions to write to a series is infered from the filename.
  * All the examples above have use two dimensions in the series.  The container
  * used for individual members of the series must be able to hold the other
@@ -528,6 +3820,25 @@ static void* series_open(ndio_fmt_t *fmt, const char* path, const char* mode)
 { series_t *out=0;
   TRY(out=new series_t(path,mode));
   TRY(out->isok());
+  out->slab_begin=series_slab_begin;
+  out->slab_next =series_slab_next;
+  out->slab_end  =series_slab_end;
+  out->labels    =series_labels;
+  out->write_subarray=series_write_subarray;
+  out->flush     =series_flush;
+  out->map       =series_map;
+  out->unmap     =series_unmap;
+  out->cache_budget=series_cache_budget;
+  out->cache_stats=series_cache_stats;
+  out->load_begin =series_load_begin;
+  out->load_focus =series_load_focus;
+  out->load_wait  =series_load_wait;
+  out->load_cancel=series_load_cancel;
+  out->concurrency=series_concurrency;
+  out->partition  =series_partition;
+  out->stats      =series_stats;
+  out->field_count=series_field_count;
+  out->progress   =series_progress;
   return out;
 Error:
   LOG("%s(%d): %s()"ENDL "\tCould not open"ENDL "\t\t%s"ENDL "\t\twith mode \"%s\""ENDL,
@@ -545,6 +3856,9 @@ static void series_close(ndio_t file)
 /**
  * Iterate over file's in the path recording min and max's for dims in names.
  * Open one to get the shape.
+ *
+ * The file name fields are the last dimensions unless
+ * ndio_series_params_t::dims places them elsewhere.
  */
 static nd_t series_shape(ndio_t file)
 { series_t *self=(series_t*)ndioContext(file);
@@ -552,40 +3866,88 @@ static nd_t series_shape(ndio_t file)
   TPos mn,mx;
   TRY(self->minmax(mn,mx));
   TRY(shape=self->single_file_shape());
+  if(self->params.dims[0]<0)
   { size_t i,o=ndndim(shape);
     ndInsertDim(shape,(unsigned)(o+mx.size()-1));
     for(i=0;i<mn.size();++i)
       ndShapeSet(shape,(unsigned)(o+i),mx[i]-mn[i]+1);
+  } else
+  { std::vector<unsigned> fd;
+    size_t sh[32];
+    unsigned i,k,j=0,n=ndndim(shape)+(unsigned)mn.size();
+    TRY(n<=countof(sh));
+    TRY(self->field_dims(fd,n));
+    for(i=0;i<n;++i)
+    { for(k=0;k<fd.size() && fd[k]!=i;++k) {}
+      sh[i]=(k<fd.size())?(mx[k]-mn[k]+1):ndshape(shape)[j++];
+    }
+    TRY(ndreshape(shape,n,sh));
   }
   return shape;
 Error:
+  ndfree(shape);
   return 0;
 }
 
 /**
  * Reads a file series into \a dst.
+ *
+ * If the type of \a dst differs from the member files' type, each member is
+ * converted as it's copied into place.  See ndio_series_params_t.
+ *
+ * If ndio_series_params_t::dims puts the file name fields somewhere other
+ * than the last dimensions of \a dst, each member is decoded into scratch
+ * space and scattered into place, so no transpose is needed afterwards.
  */
 static unsigned series_read(ndio_t file,nd_t dst)
 { series_t *self=(series_t*)ndioContext(file);
-  const size_t o=ndndim(dst)-self->ndim_;
-  DIR *dir;
-  struct dirent *ent;
+  series_t::TSeekTable members;
+  series_t::TSeekTable::const_iterator it;
+  std::vector<unsigned> fd;
+  std::vector<size_t> ipos;
   TPos mn,mx;
-  TRY(self->minmax(mn,mx));
-  TRYMSG(mn.size()>0,"Could not find files that matched the file series pattern.");
+  size_t bytes;
+  bool inplace;
   TRY(self->isr_);
-  TRYMSG(dir=opendir(self->path_.c_str()),strerror(errno));
-  while((ent=readdir(dir))!=NULL)
-  { TPos v;
-    ndio_t file=0;
-    if(!self->parse(ent->d_name,v))               continue;
-    if(!(file=openfile(self->path_,ent->d_name))) continue;
-    for(size_t i=0;i<self->ndim_;++i) //  set the read position
-      ndoffset(dst,(unsigned)(o+i),v[i]-mn[i]);
-    ndioClose(ndioRead(file,dst));
-    for(size_t i=0;i<self->ndim_;++i) //reset the read position
-      ndoffset(dst,(unsigned)(o+i),-(int64_t)v[i]+(int64_t)mn[i]);
+  self->drain();                     // see what's been written
+  TRY(self->field_dims(fd,ndndim(dst)));
+  inplace=series_t::trailing(fd,ndndim(dst)); // otherwise each member is scattered
+  TRY(self->index(members,mn,mx));
+  TRYMSG(mn.size()>0,"Could not find files that matched the file series pattern.");
+  if(self->params.stats) self->stats_begin(ndtype(dst),mn,mx);
+  else                   self->stats_clear();
+  self->nbad_=0;
+  self->progress_begin(members.size());
+  if(self->tuner_.ceiling()>1 && members.size()>1)
+  { TRY(self->member_type());        // before there are several readers
+    self->read_parallel(members,mn,dst,fd);
+    TRYMSG(self->progress_end(),"Cancelled by the progress callback.");
+    TRYMSG(self->nbad_==0,"Some member files failed verification.");
+    return 1;
   }
+  bytes=series_t::member_bytes(dst,fd);
+  ipos.resize(self->ndim_);
+  for(it=members.begin();it!=members.end();++it)
+  { const TPos& v=it->first;
+    for(size_t i=0;i<self->ndim_;++i)
+      ipos[i]=v[i]-mn[i];
+    if(inplace)
+    { for(size_t i=0;i<self->ndim_;++i) //  set the read position
+        ndoffset(dst,fd[i],ipos[i]);
+      self->counted(&self->scratch_,&ipos[0],[&]()
+      { return self->read_named(it->second,dst,NULL);
+      });
+      for(size_t i=0;i<self->ndim_;++i) //reset the read position
+        ndoffset(dst,fd[i],-(int64_t)ipos[i]);
+    } else
+      self->counted(&self->scratch_,&ipos[0],[&]()
+      { return self->scatter(it->second,dst,fd,&ipos[0]);
+      });
+    if(!self->progressed(bytes))
+      break;                         // at a file boundary
+  }
+  TRYMSG(self->progress_end(),"Cancelled by the progress callback.");
+  TRYMSG(self->nbad_==0,"Some member files failed verification.");
   return 1;
 Error:
   return 0;
@@ -593,19 +3955,19 @@ Error:
 
 // helpers for the write function
 /// (for writing) set offset for writing a sub-array
-static void setpos(nd_t src,const size_t o,const std::vector<size_t>& ipos)
+static void setpos(nd_t src,const std::vector<unsigned>& fd,const std::vector<size_t>& ipos)
 { for(size_t i=0;i<ipos.size();++i)
-    ndoffset(src,(unsigned)(o+i),ipos[i]);
+    ndoffset(src,fd[i],ipos[i]);
 }
 /// (for writing) Undo setpos() by negating the offset for writing a sub-array
-static void unsetpos(nd_t src,const size_t o,const std::vector<size_t>& ipos)
+static void unsetpos(nd_t src,const std::vector<unsigned>& fd,const std::vector<size_t>& ipos)
 { for(size_t i=0;i<ipos.size();++i)
-    ndoffset(src,(unsigned)(o+i),-(int64_t)ipos[i]);
+    ndoffset(src,fd[i],-(int64_t)ipos[i]);
 }
 /// (for writing) Maybe increment sub-array position, otherwise stop iteration.
-static bool inc(nd_t src,size_t o,std::vector<size_t> &ipos)
+static bool inc(nd_t src,const std::vector<unsigned>& fd,std::vector<size_t> &ipos)
 { int kdim=(int)ipos.size()-1;
-  while(kdim>=0 && ipos[kdim]==ndshape(src)[o+kdim]-1) // carry
+  while(kdim>=0 && ipos[kdim]==ndshape(src)[fd[kdim]]-1) // carry
     ipos[kdim--]=0;
   if(kdim<0) return 0;
   ipos[kdim]++;
@@ -618,32 +3980,114 @@ static bool inc(nd_t src,size_t o,std::vector<size_t> &ipos)
 }
 
 /**
- * Write a file series.
+ * Writes a file series, see series_write().
+ *
+ * In incremental mode (see ndio_series_params_t::incremental) each member's
+ * slab is hashed first, and the member file is only encoded and written if
+ * the hash differs from the one recorded by the last write.
+ *
+ * In durable mode (see ndio_series_params_t::durable) each member is written
+ * to a temporary file and renamed into place once its data is on disk.  The
+ * syncs are batched so there's one directory sync per
+ * ndio_series_params_t::batch files.
+ *
+ * In append mode ("a") the last file name field continues from the end of
+ * the previous write, or from the end of the existing series for the first
+ * write, without listing the directory again.
+ *
+ * By default the file name fields index the last dimensions of \a src.  When
+ * ndio_series_params_t::dims says otherwise, each member is gathered from
+ * \a src into a scratch buffer before it's written.
  */
-static unsigned series_write(ndio_t file, nd_t src)
-{ series_t *self=(series_t*)ndioContext(file);
-  size_t o;
-  std::string outname;
+static unsigned write_now(series_t *self, nd_t src)
+{ const unsigned n=ndndim(src);
   std::vector<size_t> ipos;
+  std::vector<unsigned> fd;
+  commit_t *commit=0;
+  size_t count=1,bytes;
+  bool inplace;
   TRY(self->isw_); // is writable?
+  TRY(self->field_dims(fd,n));
+  inplace=series_t::trailing(fd,n); // otherwise each member is gathered
   ipos.assign(self->ndim_,0);
-  o=ndndim(src)-1;
+  if(self->params.durable)
+    commit=new commit_t(self->params.batch);
+  for(size_t i=0;i<fd.size();++i)
+    count*=ndshape(src)[fd[i]];
+  bytes=series_t::member_bytes(src,fd);
+  self->progress_begin(count);
+  if(!self->params.pack && self->tuner_.ceiling()>1 && count>1)
+  { std::vector<std::vector<size_t> > all;  // several at once, each gathered into its thread's scratch
+    std::atomic<bool> bad(false);
+    size_t nfailed;
+    do all.push_back(ipos); while(inc(src,fd,ipos));
+    nfailed=self->run(all.size(),bytes,[&](size_t i,scratch_t *scratch)
+    { nd_t m=self->gather(src,fd,all[i],scratch);
+      bool ok;
+      if(!m) bad=true;
+      ok=m && self->put(all[i],m,commit);
+      self->progressed(bytes);
+      return ok;
+    });
+    if(bad || (nfailed && commit))
+      goto Error;
+  } else
   do
-  { setpos(src,o,ipos);
-    ndsetndim(src,o-self->ndim_+1);  // drop dimensionality
-    TRY(self->makename(outname,ipos));
-    ndioClose(ndioWrite(ndioOpen(outname.c_str(),NULL,"w"),src));
-    ndsetndim(src,o+1);              // restore dimensionality
-    unsetpos(src,o,ipos);
-  } while (inc(src,o,ipos));
-  self->last_+=ipos.back();
+  { nd_t m=src;
+    if(inplace)
+    { setpos(src,fd,ipos);
+      ndsetndim(src,n-self->ndim_);  // drop dimensionality
+    } else
+      TRY(m=self->gather(src,fd,ipos));
+    if(!self->put(ipos,m,commit) && commit)
+      goto Error;                    // only durable writes are all-or-nothing
+    if(inplace)
+    { ndsetndim(src,n);              // restore dimensionality
+      unsetpos(src,fd,ipos);
+    }
+  } while (self->progressed(bytes) && inc(src,fd,ipos)); // stop at a file boundary if cancelled
+  if(!self->progress_end())
+  { if(!commit)                      // durable writes are dropped on cancel, as on failure
+      self->save_sidecars();         // for the members that were written
+    FAIL("Cancelled by the progress callback.");
+  }
+  if(self->isa_)
+    self->last_+=ndshape(src)[fd.back()]; // the next write follows this one
+  if(commit)
+  { TRY(commit->commit());
+    delete commit;
+    commit=0;
+  }
+  TRY(self->save_sidecars());
   return 1;
+Error:
+  self->progress_end();
+  if(commit) delete commit;          // removes uncommitted temporaries
+  return 0;
+}
+
+/**
+ * Write a file series.
+ *
+ * In async mode (see ndio_series_params_t::async) \a src is copied onto the
+ * background writer's queue and this returns straight away.  Errors are
+ * reported by ndioSeriesFlush().
+ */
+static unsigned series_write(ndio_t file, nd_t src)
+{ series_t *self=(series_t*)ndioContext(file);
+  TRY(self->isw_); // is writable?
+  if(self->writer_)
+    return self->writer_->push(src);
+  return write_now(self,src);
 Error:
   return 0;
 }
 
 /**
  * Seek
+ *
+ * In follow mode (see ndio_series_params_t::follow) a seek to a member file
+ * that doesn't exist yet waits for it to be written.
  */
 static unsigned series_seek(ndio_t file, nd_t dst, size_t *pos)
 { series_t *self=(series_t*)ndioContext(file);
@@ -655,6 +4099,10 @@ static unsigned series_seek(ndio_t file, nd_t dst, size_t *pos)
   size_t odim=ndndim(dst);
   ALLOCA(size_t,shape,ndndim(dst));
   memcpy(shape,ndshape(dst),ndndim(dst)*sizeof(size_t)); // save dst shape
+  TRYMSG(self->params.dims[0]<0,"Sub-array reads don't support remapped series dimensions.");
+  self->drain();               // see what's been written
+  if(self->params.follow)
+    TRY(self->wait(NULL));     // need a member file to know what's seekable
   for(size_t i=0;i<ndndim(dst);++i)
     if(self->canseek(i))
       ndshape(dst)[i]=1;       // reduce dst shape to 1 on seekable dims...don't change strides
@@ -664,16 +4112,27 @@ static unsigned series_seek(ndio_t file, nd_t dst, size_t *pos)
               pos+self->fdim_,
               pos+self->fdim_+self->ndim_);
   vadd(ipos,mn);
+  if(self->params.follow)
+    TRY(self->wait(&ipos));
   TRY(self->find(outname,ipos));
-  { TRY(t=ndioOpen(outname.c_str(),NULL,"r"));
+  if(self->pack_ || self->caching())
+  { TRY(ndreshape(dst,(unsigned)(self->fdim_),ndshape(dst))); // temporarily lower dimension
+    TRY(self->read_named(outname.substr(self->path_.empty()?0:self->path_.size()+1),dst,pos));
+    TRY(ndreshape(dst,(unsigned)odim,ndshape(dst))); // restore dimensionality
+  } else
+  { std::future<bool> good=self->check(outname);
+    TRY(t=ndioOpen(outname.c_str(),NULL,"r"));
     TRY(ndreshape(dst,(unsigned)(self->fdim_),ndshape(dst))); // temporarily lower dimension
-    TRY(ndioReadSubarray(t,dst,pos,NULL));
+    TRY(self->read_member(t,dst,pos));
     ndioClose(t);t=0;
     TRY(ndreshape(dst,(unsigned)odim,ndshape(dst))); // restore dimensionality
+    TRY(good.get());
   }
   memcpy(ndshape(dst),shape,ndndim(dst)*sizeof(size_t)); // restore dst shape
   return 1;
 Error:
+  if(ndndim(dst)!=odim)
+    ndreshape(dst,(unsigned)odim,ndshape(dst)); // restore dimensionality
   memcpy(ndshape(dst),shape,ndndim(dst)*sizeof(size_t)); // restore dst shape
   if(ndioError(t))
   { LOG("\t[Sub file error]"ENDL "\t\tFile: %s"ENDL "\t\t%s"ENDL,
@@ -683,6 +4142,43 @@ Error:
   return 0;
 }
 
+/**
+ * Set parameters.
+ * \a param should point to an ndio_series_params_t.
+ */
+static unsigned series_set(ndio_t file, void *param, size_t nbytes)
+{ series_t *self=(series_t*)ndioContext(file);
+  TRYMSG(param,"Parameters must not be NULL.");
+  TRYMSG(nbytes==sizeof(ndio_series_params_t),"Expected an ndio_series_params_t.");
+  self->drain();                     // the writer reads params
+  self->end_load();                  // ...and so does the loader
+  self->end_slabs();                 // ...and the slab worker
+  self->end_map();                   // ...and the map's fault handler
+  self->params=*(ndio_series_params_t*)param;
+  self->labels_.clear();
+  self->tuner_.limit(self->params.threads,self->params.max_threads);
+  TRYMSG(!self->params.pack || !(self->params.durable || self->params.incremental || self->params.checksum),
+         "Packed series don't support durable, incremental or checksum.");
+  TRYMSG(!self->params.stats || self->params.hist_lo==self->params.hist_hi || self->params.hist_lo<self->params.hist_hi,
+         "The stats histogram needs hist_lo < hist_hi.");
+  TRY(self->set_roots(self->params.roots));
+  if(self->params.watch || self->params.follow) { TRY(self->watch()); }
+  else                   self->unwatch();
+  if(self->params.async && self->isw_) { TRY(self->start_writer()); }
+  else if(self->writer_)               { TRY(self->stop_writer()); }
+  return 1;
+Error:
+  return 0;
+}
+
+/**
+ * \returns a pointer to the series' ndio_series_t.
+ */
+static void* series_get(ndio_t file)
+{ series_t *self=(series_t*)ndioContext(file);
+  return (ndio_series_t*)self;
+}
+
 /**
  * Query which dimensions ares seekable.
  */
@@ -715,8 +4211,8 @@ shared const ndio_fmt_t* ndio_get_format_api(void)
     series_shape,
     series_read,
     series_write,
-    NULL, // set
-    NULL, // get
+    series_set,
+    series_get,
     series_canseek,
     series_seek,
     NULL, // subarray
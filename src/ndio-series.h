@@ -0,0 +1,521 @@
+/**
+ * \file
+ * Parameters for the ndio-series plugin.
+ *
+ * The plugin is configured per handle through the generic ndioSet() and
+ * ndioGet() calls:
+ *
+ * \code{c}
+ * ndio_t file=ndioOpen("vol.%.tif",ndioFormat("series"),"r");
+ * ndio_series_params_t p=((ndio_series_t*)ndioGet(file))->params;
+ * p.scale=1.0/4096.0;
+ * ndioSet(file,&p,sizeof(p));
+ * \endcode
+ *
+ * Start from the parameters returned by ndioGet() so that fields you don't
+ * care about keep their defaults.
+ */
+#ifndef H_NDIO_SERIES
+#define H_NDIO_SERIES
+
+#include <string.h>
+#include <stdint.h>
+#include "nd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NDIO_SERIES_MAX_FIELDS 8 ///< Most numbered fields a file name pattern can have.
+
+/** How a striped series spreads member files over its roots.  See ndio_series_params_t::roots. */
+enum
+{ NDIO_SERIES_STRIPE_ROUND_ROBIN=0, ///< By the sum of the file name numbers, so neighbours along any field are on different roots.
+  NDIO_SERIES_STRIPE_HASH           ///< By a hash of the file name.
+};
+
+/**
+ * Settable parameters for a series.
+ *
+ * Reads convert the member files' pixels to the type of the destination
+ * array.  When the types differ, or when a scale, offset or clamp is
+ * requested, each member file is converted as it is copied into place:
+ *
+ * \verbatim
+   dst = saturate( clamp( scale*src+offset, lo, hi ) )
+   \endverbatim
+ *
+ * where \c saturate limits the result to the range of the destination type.
+ */
+typedef struct _ndio_series_params_t
+{ double   scale,  ///< (read) Multiplies source values.  Default: 1.
+           offset; ///< (read) Added after scaling.      Default: 0.
+  double   lo,hi;  ///< (read) Clamp range.  Only used when \a clamp is set.
+  unsigned clamp;  ///< (read) If non-zero, clamp converted values to [lo,hi].
+  unsigned incremental; ///< (write) If non-zero, only write member files whose
+                        ///< content changed since the last incremental write.
+                        ///< Content hashes are kept in a hidden sidecar file
+                        ///< next to the series, e.g. <tt>.vol.%.tif.ndio-series</tt>.
+                        ///< Not with \a pack.
+  unsigned watch;       ///< (read) If non-zero, keep the index of member files up
+                        ///< to date with inotify as files are written, instead
+                        ///< of listing the directory for every query.  Files
+                        ///< still open for writing aren't indexed until they're
+                        ///< closed.  Linux only.
+  unsigned follow;      ///< (read) If non-zero, a seek to a member file that doesn't
+                        ///< exist yet waits until it's been written and closed.
+                        ///< Implies \a watch.
+  int      timeout_ms;  ///< (read) How long a \a follow seek waits, in milliseconds.
+                        ///< Negative waits forever.  Default: -1.
+  unsigned durable;     ///< (write) If non-zero, member files are written under a
+                        ///< temporary name and atomically renamed into place once
+                        ///< their data is on disk.  A crash never leaves a
+                        ///< partially written member file.  Not with \a pack.
+  unsigned batch;       ///< (write) Number of files to sync and rename together in
+                        ///< \a durable mode.  Default: 64.
+  int      dims[NDIO_SERIES_MAX_FIELDS]; ///< (read/write) \c dims[i] is the dimension
+                        ///< of the array indexed by the i'th number in the file
+                        ///< names.  The other dimensions, in order, make up each
+                        ///< member file.  If \c dims[0] is negative (the default)
+                        ///< the numbers index the last dimensions in order.
+                        ///< ndioShape() follows the mapping.  Sub-array reads and
+                        ///< slabs need the default.
+  unsigned compact;     ///< (read) If non-zero, the numbers used along each file
+                        ///< name field are renumbered 0..n-1 in increasing order,
+                        ///< so files numbered 0,1000,2000 make a dimension of size
+                        ///< 3 instead of 2001.  See ndioSeriesLabels().
+  size_t   write_budget; ///< (write) Most bytes of partly written member files that
+                        ///< ndioSeriesWriteSubarray() keeps in memory.  Default: 256 MB.
+  unsigned async;       ///< (write) If non-zero, ndioWrite() copies the array onto a
+                        ///< queue and returns while a background thread writes it.
+                        ///< Call ndioSeriesFlush() to wait for the writes and get
+                        ///< any errors.  Closing the series also waits.
+  size_t   queue_budget; ///< (write) Most bytes the \a async queue holds, including the
+                        ///< array being written.  ndioWrite() blocks until there's
+                        ///< room.  Default: 256 MB.
+  unsigned pack;        ///< (write) If non-zero, members go into one pack file named
+                        ///< after the pattern, e.g. <tt>vol.%.tif.pack</tt>, instead
+                        ///< of one file each.  Members are stored as raw pixels and
+                        ///< the pack's index is written by ndioSeriesFlush() or on
+                        ///< close.  Reading a series uses its pack automatically
+                        ///< when there is one.  Not with \a durable,
+                        ///< \a incremental or \a checksum.
+  const char *roots;    ///< (read/write) If not NULL, the series is striped over
+                        ///< these directories instead of living in the one in its
+                        ///< name.  A list separated by ':' (';' on Windows).  Each
+                        ///< member file goes in one root, and each root on its own
+                        ///< is an ordinary series.  Reads list every root and read
+                        ///< them in parallel.  The string is copied.  Not with
+                        ///< \a watch, \a follow or \a pack.
+  unsigned stripe;      ///< (write) How member files are spread over the \a roots.
+                        ///< NDIO_SERIES_STRIPE_ROUND_ROBIN (the default) or
+                        ///< NDIO_SERIES_STRIPE_HASH.
+  unsigned threads;     ///< (read/write) How many member files ndioRead(), ndioWrite()
+                        ///< and ndioSeriesLoadBegin() work on at once.  0 (the
+                        ///< default) tunes it as it goes, climbing towards the
+                        ///< number that gives the most MB/s.  See
+                        ///< ndioSeriesConcurrency().
+  unsigned max_threads; ///< (read/write) Most member files at once when \a threads is
+                        ///< 0.  Default: 16.
+  unsigned stats;       ///< (read) If non-zero, ndioRead() collects statistics of the
+                        ///< values it writes as each member file is copied in, for
+                        ///< each member and overall.  See ndioSeriesStats().
+  double   hist_lo,hist_hi; ///< (read) Range of the \a stats histogram, [hist_lo,hist_hi).
+                        ///< If they're equal (the default) it's the range of the
+                        ///< array's type, or [0,1) for floating point.  NaNs
+                        ///< aren't counted in any of the statistics.
+  unsigned checksum;    ///< (write) If non-zero, the CRC-32C of each member file is
+                        ///< kept in a sidecar next to the series.  Not with \a pack.
+  unsigned verify;      ///< (read) If non-zero, member files are checked against their
+                        ///< recorded CRC-32C while they're decoded, and a read fails
+                        ///< if any don't match.  Files without one aren't checked.
+} ndio_series_params_t;
+
+/** Progress of an ndioRead() or ndioWrite().  See ndioSeriesProgress(). */
+typedef struct _ndio_series_progress_t
+{ size_t   done,  ///< Member files finished so far, including any that failed.
+           total; ///< Member files in the read or write.
+  uint64_t bytes; ///< Bytes of array data in the finished members.
+} ndio_series_progress_t;
+
+/** What a progress callback returns.  See ndioSeriesProgress(). */
+enum
+{ NDIO_SERIES_CONTINUE=0, ///< Carry on.
+  NDIO_SERIES_CANCEL      ///< Stop before the next member file.
+};
+
+/** A progress callback.  See ndioSeriesProgress(). */
+typedef int (*ndio_series_progress_fn)(const ndio_series_progress_t *progress, void *user);
+
+/** Tile cache statistics.  See ndioSeriesCacheStats(). */
+typedef struct _ndio_series_cache_stats_t
+{ size_t hits,      ///< Reads of a member file served from the cache.
+         misses,    ///< Reads of a member file that had to decode it.
+         evictions, ///< Decoded members dropped to stay within the budget.
+         bytes,     ///< Bytes of decoded members held.
+         budget,    ///< The budget.  See ndioSeriesCacheBudget().
+         ntiles;    ///< Decoded members held.
+} ndio_series_cache_stats_t;
+
+/** Number of bins in the histogram from ndioSeriesStats(). */
+#define NDIO_SERIES_HIST_BINS 256
+
+/** Statistics of values read in stats mode.  See ndioSeriesStats(). */
+typedef struct _ndio_series_stats_t
+{ double min,max,mean;
+  size_t count;         ///< number of values.  0 for a member file that's missing or failed to read.
+} ndio_series_stats_t;
+
+/**
+ * The view of a series returned by ndioGet().
+ *
+ * The function pointers are filled in by the plugin.  Call them through the
+ * ndioSeries*() functions below, which check that a handle really is a
+ * series.
+ */
+typedef struct _ndio_series_t
+{ ndio_series_params_t params; ///< Current parameters.  Change them with ndioSet().
+  unsigned (*slab_begin)(ndio_t file, const size_t *shape, size_t budget);
+  unsigned (*slab_next) (ndio_t file, nd_t *slab, size_t *origin);
+  void     (*slab_end)  (ndio_t file);
+  const size_t* (*labels)(ndio_t file, unsigned ifield, size_t *n);
+  unsigned (*write_subarray)(ndio_t file, nd_t src, const size_t *origin, const size_t *shape);
+  unsigned (*flush)(ndio_t file);
+  nd_t     (*map)(ndio_t file, size_t budget);
+  void     (*unmap)(ndio_t file);
+  void     (*cache_budget)(ndio_t file, size_t bytes);
+  void     (*cache_stats)(ndio_t file, ndio_series_cache_stats_t *stats);
+  unsigned (*load_begin)(ndio_t file, nd_t dst, const size_t *focus);
+  unsigned (*load_focus)(ndio_t file, const size_t *focus);
+  unsigned (*load_wait) (ndio_t file, const size_t *pos, int timeout_ms);
+  void     (*load_cancel)(ndio_t file);
+  unsigned (*concurrency)(ndio_t file);
+  unsigned (*partition)(ndio_t file, unsigned rank, unsigned nworkers, size_t *origin, size_t *shape);
+  const ndio_series_stats_t* (*stats)(ndio_t file, ndio_series_stats_t *all, size_t *hist, size_t *nplanes);
+  unsigned (*field_count)(ndio_t file);
+  void     (*progress)(ndio_t file, ndio_series_progress_fn fn, void *user);
+} ndio_series_t;
+
+/// @cond DEFINES
+#if defined(_MSC_VER) && !defined(__cplusplus)
+#define NDIO_SERIES_INLINE static __inline
+#else
+#define NDIO_SERIES_INLINE static inline
+#endif
+/// @endcond
+
+/** \returns the series view of \a file, or NULL if \a file isn't a series. */
+NDIO_SERIES_INLINE ndio_series_t* ndioSeries(ndio_t file)
+{ const char *name=file?ndioFormatName(file):0;
+  return (name && strcmp(name,"series")==0)?(ndio_series_t*)ndioGet(file):0;
+}
+
+/**
+ * Starts reading \a file in slabs, for series that are too big to read at
+ * once.
+ *
+ * Each slab covers the full extent of the member files and \a shape[i]
+ * positions along the i'th series dimension (the dimensions encoded in the
+ * filenames).  A zero in \a shape covers the whole extent of that dimension.
+ * Slabs at the end of a dimension may be smaller.
+ *
+ * Upcoming slabs are read on a background thread while the caller works on
+ * the current one.  The slab buffers are owned by the series and at most
+ * \a budget bytes of them are held at once.  A \a budget of 0 means two
+ * slabs (double-buffering).
+ *
+ * The member index is taken once here, so iterating doesn't list the
+ * directory again.  ndioSet() ends the iteration.
+ *
+ * \returns 1 on success, otherwise 0.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesSlabBegin(ndio_t file, const size_t *shape, size_t budget)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->slab_begin)?s->slab_begin(file,shape,budget):0;
+}
+
+/**
+ * Gets the next slab, in order with the first series dimension varying
+ * fastest.
+ *
+ * \param[out] slab    Set to the slab.  It stays valid until the next call to
+ *                     ndioSeriesSlabNext() or ndioSeriesSlabEnd().
+ * \param[out] origin  If not NULL, receives the position of the slab in the
+ *                     whole series.  Must have room for ndndim(ndioShape(file))
+ *                     elements.
+ * \returns 1 if a slab was produced, 0 when there are no more slabs or on
+ *          error.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesSlabNext(ndio_t file, nd_t *slab, size_t *origin)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->slab_next)?s->slab_next(file,slab,origin):0;
+}
+
+/** Stops slab iteration and releases the slab buffers. */
+NDIO_SERIES_INLINE void ndioSeriesSlabEnd(ndio_t file)
+{ ndio_series_t *s=ndioSeries(file);
+  if(s && s->slab_end) s->slab_end(file);
+}
+
+/**
+ * In compact mode (see ndio_series_params_t::compact), maps positions along
+ * a series dimension back to the numbers in the file names.
+ *
+ * \param[in]  ifield  Which number in the file names, counting from 0 on the
+ *                     left.
+ * \param[out] n       If not NULL, receives the number of positions.
+ * \returns the file name number for each position, in increasing order, or
+ *          NULL on error.  Owned by \a file; valid until the next query.
+ */
+NDIO_SERIES_INLINE const size_t* ndioSeriesLabels(ndio_t file, unsigned ifield, size_t *n)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->labels)?s->labels(file,ifield,n):0;
+}
+
+/**
+ * Writes part of a series, for series that are too big to hold in memory.
+ *
+ * \a src is the block of the series at \a origin.  \a shape is the shape of
+ * the whole series and must be the same for every call.  The file name
+ * fields are the last dimensions.
+ *
+ * Member files that \a src covers completely are written immediately.
+ * Partly covered members are assembled in memory, starting from the existing
+ * file if there is one, and written once every pixel has been supplied.  See
+ * ndio_series_params_t::write_budget.  Blocks must not overlap.
+ *
+ * \returns 1 on success, otherwise 0.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesWriteSubarray(ndio_t file, nd_t src, const size_t *origin, const size_t *shape)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->write_subarray)?s->write_subarray(file,src,origin,shape):0;
+}
+
+/**
+ * Waits for \a async writes to finish, and writes out member files that
+ * ndioSeriesWriteSubarray() has only partly filled, as they are.  Closing
+ * the series does the same but can't report errors.
+ *
+ * \returns 1 if every member file since the last flush was written,
+ *          otherwise 0.  The files that failed are logged.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesFlush(ndio_t file)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->flush)?s->flush(file):0;
+}
+
+/**
+ * Maps the whole series into memory without reading it, for looking at
+ * small, unpredictable parts of a large series.
+ *
+ * The array has the shape and pixel type of ndioShape(file), but nothing is
+ * read until a page is first touched.  Then the member files that overlap
+ * it are read in.  At most \a budget bytes stay resident; past that, the
+ * parts that were read in longest ago are dropped and read again if they're
+ * touched again.  A \a budget of 0 means two member files' worth.
+ *
+ * The array is read-only: writing to it crashes.  Member files that are
+ * missing, or that fail to read, appear as zeros.  Read failures are logged.
+ * Passing the array to a system call, e.g. write(), may fail with EFAULT
+ * for pages that haven't been touched yet.
+ *
+ * Linux only (userfaultfd).  The member index is taken once, here.
+ *
+ * \returns the array, or NULL on error.  Owned by \a file; valid until
+ *          ndioSeriesUnmap(), the next ndioSeriesMap(), ndioSet() or the
+ *          series is closed.
+ */
+NDIO_SERIES_INLINE nd_t ndioSeriesMap(ndio_t file, size_t budget)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->map)?s->map(file,budget):0;
+}
+
+/** Releases the array returned by ndioSeriesMap(). */
+NDIO_SERIES_INLINE void ndioSeriesUnmap(ndio_t file)
+{ ndio_series_t *s=ndioSeries(file);
+  if(s && s->unmap) s->unmap(file);
+}
+
+/**
+ * Sets the memory budget of the tile cache.
+ *
+ * The tile cache keeps decoded member files for reads that revisit them,
+ * e.g. a sliding window along a series dimension.  A read that hits the
+ * cache just copies out the part it needs.  The least recently used members
+ * are dropped to stay within \a bytes.  A cached member is used while its
+ * file's mtime and size are unchanged, so it's re-read after the file is
+ * rewritten.  Packed series aren't cached.
+ *
+ * The cache, and so its budget, is shared by every series in the process;
+ * \a file may be any open series.  The budget starts at 0, which turns the
+ * cache off.
+ *
+ * \returns 1 on success, otherwise 0.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesCacheBudget(ndio_t file, size_t bytes)
+{ ndio_series_t *s=ndioSeries(file);
+  if(!s || !s->cache_budget) return 0;
+  s->cache_budget(file,bytes);
+  return 1;
+}
+
+/**
+ * Gets the tile cache's hit and miss counts since the process started,
+ * for sizing the budget.  See ndioSeriesCacheBudget().
+ *
+ * \returns 1 on success, otherwise 0.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesCacheStats(ndio_t file, ndio_series_cache_stats_t *stats)
+{ ndio_series_t *s=ndioSeries(file);
+  if(!s || !s->cache_stats || !stats) return 0;
+  s->cache_stats(file,stats);
+  return 1;
+}
+
+/**
+ * Starts reading the whole series into \a dst in the background, member
+ * files nearest \a focus first.
+ *
+ * Meant for viewers: the part being looked at shows up first and the rest
+ * fills in outward from it.  \a focus has one entry per file name field,
+ * giving a position in \a dst along that field's dimension (see
+ * ndio_series_params_t::dims).  Members are ordered by their Euclidean
+ * distance from it.  NULL means the first member.
+ *
+ * \a dst must have the shape ndioShape() reports and stay valid until the
+ * load is finished or cancelled.  Wait with ndioSeriesLoadWait() before
+ * looking at a part of it.  Any earlier load on \a file is cancelled.
+ * Changing parameters with ndioSet() cancels it too.  The member index is
+ * taken once, here.
+ *
+ * \returns 1 on success, otherwise 0.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesLoadBegin(ndio_t file, nd_t dst, const size_t *focus)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->load_begin)?s->load_begin(file,dst,focus):0;
+}
+
+/**
+ * Moves the focus of the current load.  Members that haven't been started
+ * are re-ordered around \a focus; ones being read finish first.
+ * \returns 1 on success, 0 if there's no load.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesLoadFocus(ndio_t file, const size_t *focus)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->load_focus)?s->load_focus(file,focus):0;
+}
+
+/**
+ * Waits for the member at file name position \a pos to be loaded, or for
+ * the whole load if \a pos is NULL.  \a pos is in the same coordinates as
+ * the focus.  A negative \a timeout_ms waits for as long as it takes; 0
+ * just checks.
+ *
+ * \returns 1 if it's loaded, 0 if it timed out, failed, was cancelled or
+ *          there's no member at \a pos.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesLoadWait(ndio_t file, const size_t *pos, int timeout_ms)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->load_wait)?s->load_wait(file,pos,timeout_ms):0;
+}
+
+/**
+ * Cancels the current load.  Members being read are finished; the rest
+ * are dropped.  Once this returns, \a dst isn't touched again.
+ */
+NDIO_SERIES_INLINE void ndioSeriesLoadCancel(ndio_t file)
+{ ndio_series_t *s=ndioSeries(file);
+  if(s && s->load_cancel) s->load_cancel(file);
+}
+
+/**
+ * \returns how many member files \a file currently reads or writes at once,
+ *          or 0 if it isn't a series.  See ndio_series_params_t::threads.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesConcurrency(ndio_t file)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->concurrency)?s->concurrency(file):0;
+}
+
+/**
+ * Splits a series between \a nworkers processes and gives the part for
+ * worker \a rank, numbered from 0.
+ *
+ * The parts are slabs along the last file name field, like
+ * ndioSeriesSlabBegin()'s, chosen so each holds about the same number of
+ * member file bytes.  Read a part with ndioReadSubarray() into an array of
+ * shape \a shape at \a origin.  When there are more workers than positions
+ * along the field some parts are empty: \a shape is 0 along it.
+ *
+ * Every worker gets the same split as long as the series isn't changing.
+ * The member sizes are kept in a sidecar file next to the series, so only
+ * the first worker has to stat the member files.
+ *
+ * \a origin and \a shape must have room for one entry per dimension of
+ * ndioShape().
+ *
+ * \returns 1 on success, otherwise 0.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesPartition(ndio_t file, unsigned rank, unsigned nworkers, size_t *origin, size_t *shape)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->partition)?s->partition(file,rank,nworkers,origin,shape):0;
+}
+
+/**
+ * Gets the statistics collected by the last ndioRead() in stats mode (see
+ * ndio_series_params_t::stats).
+ *
+ * They're gathered as each member file is copied into the array, so there's
+ * no second pass over it.  Values are counted as they were written, i.e.
+ * after any conversion.
+ *
+ * \param[out] all     If not NULL, statistics over the whole array.
+ * \param[out] hist    If not NULL, receives the NDIO_SERIES_HIST_BINS counts of
+ *                     the histogram over [hist_lo,hist_hi).  Values outside
+ *                     it are counted in the first or last bin.
+ * \param[out] nplanes If not NULL, receives the number of members.
+ * \returns statistics for each member file, indexed by file name position
+ *          with the first field varying fastest, or NULL if none were
+ *          collected.  Owned by \a file; valid until the next ndioRead().
+ */
+NDIO_SERIES_INLINE const ndio_series_stats_t* ndioSeriesStats(ndio_t file, ndio_series_stats_t *all, size_t *hist, size_t *nplanes)
+{ ndio_series_t *s=ndioSeries(file);
+  if(nplanes) *nplanes=0;
+  return (s && s->stats)?s->stats(file,all,hist,nplanes):0;
+}
+
+/**
+ * \returns the number of numbered fields in the file name pattern, which
+ *          index the last dimensions of ndioShape(), or 0 on error.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesFieldCount(ndio_t file)
+{ ndio_series_t *s=ndioSeries(file);
+  return (s && s->field_count)?s->field_count(file):0;
+}
+
+/**
+ * Sets a callback that's called as ndioRead() and ndioWrite() finish each
+ * member file, with \a user.  NULL removes it.
+ *
+ * If it returns NDIO_SERIES_CANCEL no more member files are started, and
+ * the read or write fails once those under way have finished.  Member files
+ * are never left half written, and in durable mode (see
+ * ndio_series_params_t::durable) nothing from the cancelled write is kept.
+ *
+ * Calls are never concurrent, but when several member files are read or
+ * written at once they may come from different threads, and in async mode
+ * they come from the background writer.
+ *
+ * \returns 1 on success, otherwise 0.
+ */
+NDIO_SERIES_INLINE unsigned ndioSeriesProgress(ndio_t file, ndio_series_progress_fn fn, void *user)
+{ ndio_series_t *s=ndioSeries(file);
+  if(!s || !s->progress) return 0;
+  s->progress(file,fn,user);
+  return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif //H_NDIO_SERIES
@@ -0,0 +1,232 @@
+/**
+ * \file
+ * Packed series: every member of a series in one file.
+ */
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pack.h"
+#include "xfer.h"
+
+#ifdef _MSC_VER
+#include <io.h>
+#define O_FLAGS (_O_BINARY)
+#else
+#include <unistd.h>
+#define O_FLAGS (0)
+#endif
+
+/// @cond DEFINES
+#define MAGIC       "NDPACK01"
+#define FOOTER_SIZE (2*sizeof(uint64_t)+8)
+/// @endcond
+
+#ifdef _MSC_VER
+static int64_t pread(int fd,void *buf,size_t n,uint64_t off)
+{ if(_lseeki64(fd,(__int64)off,SEEK_SET)<0) return -1;
+  return _read(fd,buf,(unsigned)n);
+}
+static int64_t pwrite(int fd,const void *buf,size_t n,uint64_t off)
+{ if(_lseeki64(fd,(__int64)off,SEEK_SET)<0) return -1;
+  return _write(fd,buf,(unsigned)n);
+}
+#define close     _close
+#define ftruncate _chsize_s
+#define fsync     _commit
+#endif
+
+/** Reads exactly \a n bytes at \a off.  \returns true on success. */
+static bool read_all(int fd,void *buf,size_t n,uint64_t off)
+{ char *p=(char*)buf;
+  while(n)
+  { int64_t r=pread(fd,p,n,off);
+    if(r<0 && errno==EINTR) continue;
+    if(r<=0) return false;
+    p+=r; off+=r; n-=(size_t)r;
+  }
+  return true;
+}
+
+/** Writes exactly \a n bytes at \a off.  \returns true on success. */
+static bool write_all(int fd,const void *buf,size_t n,uint64_t off)
+{ const char *p=(const char*)buf;
+  while(n)
+  { int64_t r=pwrite(fd,p,n,off);
+    if(r<0 && errno==EINTR) continue;
+    if(r<=0) return false;
+    p+=r; off+=r; n-=(size_t)r;
+  }
+  return true;
+}
+
+template<typename T> static void put(std::vector<char>& b,T v)
+{ b.insert(b.end(),(const char*)&v,(const char*)&v+sizeof(v));
+}
+template<typename T> static bool get(const char *&p,const char *e,T *v)
+{ if(p+sizeof(T)>e) return false;
+  memcpy(v,p,sizeof(T));
+  p+=sizeof(T);
+  return true;
+}
+
+pack_t::pack_t() : fd_(-1),end_(0),dirty_(false) {}
+
+pack_t::~pack_t()
+{ if(fd_>=0)
+  { finish();
+    close(fd_);
+  }
+}
+
+bool pack_t::open_read(const std::string& path)
+{ if((fd_=open(path.c_str(),O_RDONLY|O_FLAGS))<0)
+    return false;
+  return load_index_();
+}
+
+bool pack_t::open_write(const std::string& path, bool append)
+{ if((fd_=open(path.c_str(),O_RDWR|O_CREAT|O_FLAGS|(append?0:O_TRUNC),0666))<0)
+    return false;
+  if(append)
+  { struct stat st;
+    if(fstat(fd_,&st)<0) return false;
+    if(st.st_size>0 && !load_index_())
+      return false;
+  }
+  return true;
+}
+
+bool pack_t::load_index_()
+{ struct stat st;
+  std::vector<char> buf(1<<16);
+  uint64_t end;
+  if(fstat(fd_,&st)<0) return false;
+  if(load_index_at_(st.st_size))
+    return true;
+  // A write that didn't finish left payloads after the last footer.  Look
+  // back for that footer.
+  for(end=st.st_size;end>FOOTER_SIZE;)
+  { const size_t n=(end<buf.size())?(size_t)end:buf.size();
+    if(!read_all(fd_,&buf[0],n,end-n)) return false;
+    for(size_t i=n;i>=8;--i)
+      if(memcmp(&buf[i-8],MAGIC,8)==0 && load_index_at_(end-n+i))
+        return true;
+    end-=(n>8)?(n-7):n; // keep 7 bytes of overlap for a magic that straddles blocks
+  }
+  return false;
+}
+
+bool pack_t::load_index_at_(uint64_t end)
+{ char footer[FOOTER_SIZE];
+  uint64_t at,count,i;
+  std::vector<char> buf;
+  const char *p,*e;
+  if(end<FOOTER_SIZE) return false;
+  if(!read_all(fd_,footer,FOOTER_SIZE,end-FOOTER_SIZE)) return false;
+  if(memcmp(footer+2*sizeof(uint64_t),MAGIC,8)!=0) return false;
+  memcpy(&at,footer,sizeof(at));
+  memcpy(&count,footer+sizeof(at),sizeof(count));
+  if(at>end-FOOTER_SIZE) return false;
+  buf.resize((size_t)(end-FOOTER_SIZE-at));
+  if(!buf.empty() && !read_all(fd_,&buf[0],buf.size(),at)) return false;
+  p=buf.empty()?0:&buf[0];
+  e=p+buf.size();
+  index_.clear();
+  for(i=0;i<count;++i)
+  { pack_entry_t ent;
+    uint32_t format,ndim,namelen;
+    int32_t type;
+    if(!get(p,e,&ent.offset) || !get(p,e,&ent.nbytes) || !get(p,e,&format)
+       || !get(p,e,&type) || !get(p,e,&ndim) || !get(p,e,&namelen))
+      return false;
+    ent.format=format;
+    ent.type=(nd_type_id_t)type;
+    for(uint32_t k=0;k<ndim;++k)
+    { uint64_t n;
+      if(!get(p,e,&n)) return false;
+      ent.shape.push_back((size_t)n);
+    }
+    if(p+namelen>e) return false;
+    if(ent.offset+ent.nbytes>at) return false;
+    index_[std::string(p,namelen)]=ent;
+    p+=namelen;
+  }
+  if(p!=e) return false;              // the index fills the space before the footer
+  end_=end;
+  return true;
+}
+
+bool pack_t::add(const std::string& name, const nd_t a)
+{ pack_entry_t ent;
+  const void *data=nddata(a);
+  size_t i,expect=ndbpp(a);
+  ent.offset=end_;
+  ent.nbytes=ndnbytes(a);
+  ent.format=pack_raw;
+  ent.type=ndtype(a);
+  ent.shape.assign(ndshape(a),ndshape(a)+ndndim(a));
+  for(i=0;i<ndndim(a);++i)            // contiguous?
+  { if(ndstrides(a)[i]!=expect) break;
+    expect*=ndshape(a)[i];
+  }
+  if(i<ndndim(a))
+  { std::vector<size_t> strides(ndndim(a));
+    bounce_.resize(ent.nbytes);
+    for(i=0,expect=ndbpp(a);i<ndndim(a);++i)
+    { strides[i]=expect;
+      expect*=ndshape(a)[i];
+    }
+    if(!xfer(&bounce_[0],&strides[0],ndtype(a),data,ndstrides(a),ndtype(a),ndndim(a),ndshape(a),NULL))
+      return false;
+    data=&bounce_[0];
+  }
+  if(!write_all(fd_,data,ent.nbytes,ent.offset))
+    return false;
+  end_+=ent.nbytes;
+  index_[name]=ent;
+  dirty_=true;
+  return true;
+}
+
+bool pack_t::finish()
+{ std::vector<char> b;
+  TIndex::const_iterator it;
+  if(!dirty_) return true;
+  for(it=index_.begin();it!=index_.end();++it)
+  { const pack_entry_t& e=it->second;
+    put(b,(uint64_t)e.offset);
+    put(b,(uint64_t)e.nbytes);
+    put(b,(uint32_t)e.format);
+    put(b,(int32_t)e.type);
+    put(b,(uint32_t)e.shape.size());
+    put(b,(uint32_t)it->first.size());
+    for(size_t k=0;k<e.shape.size();++k)
+      put(b,(uint64_t)e.shape[k]);
+    b.insert(b.end(),it->first.begin(),it->first.end());
+  }
+  put(b,(uint64_t)end_);
+  put(b,(uint64_t)index_.size());
+  b.insert(b.end(),MAGIC,MAGIC+8);
+  if(fsync(fd_)!=0) return false;     // the payloads, before an index points at them
+  if(!write_all(fd_,&b[0],b.size(),end_)) return false;
+  if(ftruncate(fd_,(int64_t)(end_+b.size()))!=0) return false; // drop what an unfinished write left
+  if(fsync(fd_)!=0) return false;
+  end_+=b.size();                     // the next payloads go after this index, so it stays good
+  dirty_=false;
+  return true;
+}
+
+const pack_entry_t* pack_t::find(const std::string& name) const
+{ TIndex::const_iterator it=index_.find(name);
+  return (it==index_.end())?0:&it->second;
+}
+
+bool pack_t::read(const pack_entry_t& e, void *buf) const
+{
+#ifdef _MSC_VER
+  std::lock_guard<std::mutex> g(lock_);
+#endif
+  return read_all(fd_,buf,(size_t)e.nbytes,e.offset);
+}
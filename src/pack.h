@@ -0,0 +1,107 @@
+/**
+ * \file
+ * Packed series: every member of a series in one file.
+ *
+ * Member payloads are stored back to back, followed by an index and a
+ * fixed-size footer.  Opening a pack costs one open and two reads, and each
+ * member is then a single positioned read, so series of many small planes
+ * don't pay a per-file open, stat and close.
+ *
+ * Layout, in native byte order:
+ * \verbatim
+   payload 0 | payload 1 | ... | index | footer
+   index:  for each member
+             u64 offset, u64 nbytes, u32 format, i32 type, u32 ndim, u32 namelen,
+             u64 shape[ndim], char name[namelen]
+   footer: u64 index offset, u64 member count, char magic[8]="NDPACK01"
+   \endverbatim
+ *
+ * Members are keyed by the name they would have as separate files, so the
+ * series' usual file name parsing applies unchanged.
+ *
+ * A pack is only ever appended to.  Payloads added later go after the last
+ * footer, followed by a new index and footer, so the older index stays good
+ * until the new one is written and synced.  If writing stops part way, the
+ * reader looks back from the end of the file for the last whole footer.
+ * Indexes that were replaced are left in place as dead space.
+ */
+#ifndef H_NDIO_SERIES_PACK
+#define H_NDIO_SERIES_PACK
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include "nd.h"
+
+/** Payload encodings. */
+enum pack_format_t
+{ pack_raw=0 ///< Pixels in the member's type, dimension 0 fastest.
+};
+
+/** Where one member lives in a pack. */
+struct pack_entry_t
+{ uint64_t            offset,nbytes;
+  unsigned            format;
+  nd_type_id_t        type;
+  std::vector<size_t> shape;
+};
+
+/**
+ * Reads or writes a pack file.
+ * Reads are positioned, so several threads may read at once.
+ */
+class pack_t
+{ public:
+  typedef std::map<std::string,pack_entry_t> TIndex;
+
+  pack_t();
+  ~pack_t();
+
+  /** Opens an existing pack for reading.  \returns true on success, otherwise false. */
+  bool open_read(const std::string& path);
+
+  /**
+   * Opens a pack for writing.  With \a append, members are added to an
+   * existing pack (if there is one), otherwise the pack starts out empty.
+   * \returns true on success, otherwise false.
+   */
+  bool open_write(const std::string& path, bool append);
+
+  /**
+   * Appends \a a as the member \a name, replacing any earlier member with
+   * that name.  The index isn't written until finish(); until then, readers
+   * see the pack as it was.
+   * \returns true on success, otherwise false.
+   */
+  bool add(const std::string& name, const nd_t a);
+
+  /** Writes the index, if it has changed.  \returns true on success, otherwise false. */
+  bool finish();
+
+  /** \returns the entry for member \a name, or NULL if there isn't one. */
+  const pack_entry_t* find(const std::string& name) const;
+
+  /** Reads the payload of \a e into \a buf, which must hold e.nbytes bytes.  \returns true on success, otherwise false. */
+  bool read(const pack_entry_t& e, void *buf) const;
+
+  const TIndex& index() const { return index_; }
+
+  private:
+  int      fd_;
+  uint64_t end_;      ///< where the next payload or index goes, after the last footer
+  bool     dirty_;    ///< index changed since it was last written
+  TIndex   index_;
+  std::vector<char> bounce_; ///< for writing strided arrays
+#ifdef _MSC_VER
+  mutable std::mutex lock_;  ///< no pread() here, so reads share the file position
+#endif
+
+  bool load_index_();
+  bool load_index_at_(uint64_t end);
+  pack_t(const pack_t&);
+  pack_t& operator=(const pack_t&);
+};
+
+#endif //H_NDIO_SERIES_PACK
@@ -0,0 +1,306 @@
+/**
+ * \file
+ * Strided copies with on-the-fly type conversion.
+ *
+ * The inner loops are written so the compiler can vectorize them when the
+ * innermost dimension is contiguous in both source and destination; that's
+ * the common case when a member file is copied into the caller's array.
+ */
+#include <string.h>
+#include <math.h>
+#include <limits>
+#include "xfer.h"
+
+#ifdef _MSC_VER
+#define RESTRICT __restrict
+#else
+#define RESTRICT __restrict__
+#endif
+
+/// @cond DEFINES
+typedef void (*row_t)(char *d,size_t ds,const char *s,size_t ss,size_t n,const xfer_op_t *op);
+typedef void (*stats_row_t)(const char *d,size_t ds,size_t n,xfer_stats_t *st);
+
+typedef unsigned char      u8;
+typedef unsigned short     u16;
+typedef unsigned int       u32;
+typedef unsigned long long u64;
+typedef signed char        i8;
+typedef short              i16;
+typedef int                i32;
+typedef long long          i64;
+typedef float              f32;
+typedef double             f64;
+/// @endcond
+
+/**
+ * Working precision for a conversion.  Single precision is exact for the
+ * small integer types, so use it when both sides allow; it vectorizes twice
+ * as wide.
+ */
+template<typename T> struct small_    { enum{value=0}; };
+template<>           struct small_<u8> { enum{value=1}; };
+template<>           struct small_<u16>{ enum{value=1}; };
+template<>           struct small_<i8> { enum{value=1}; };
+template<>           struct small_<i16>{ enum{value=1}; };
+template<>           struct small_<f32>{ enum{value=1}; };
+
+template<bool B> struct work_       { typedef f64 type; };
+template<>       struct work_<true> { typedef f32 type; };
+
+/** Largest value of \a T that survives a round trip through a double. */
+template<typename T> static double maxval()
+{ double v=(double)std::numeric_limits<T>::max();
+  if(std::numeric_limits<T>::is_integer && sizeof(T)==8)
+    v=nextafter(v,0.0); // max() rounds up to 2^63 or 2^64 as a double
+  return v;
+}
+template<typename T> static double minval()
+{ return std::numeric_limits<T>::is_integer?(double)std::numeric_limits<T>::min():-std::numeric_limits<T>::max();
+}
+
+/**
+ * Convert one row of \a n elements.
+ * Strides are in bytes.  NaNs become 0 in integer types.
+ */
+template<typename TD,typename TS>
+static void row(char *d,size_t ds,const char *s,size_t ss,size_t n,const xfer_op_t *op)
+{ typedef typename work_<small_<TD>::value && small_<TS>::value>::type W;
+  const int isint=std::numeric_limits<TD>::is_integer;
+  double dlo=minval<TD>(),dhi=maxval<TD>();
+  if(op && op->clamp)
+  { dlo=(op->lo>dlo)?op->lo:dlo;
+    dhi=(op->hi<dhi)?op->hi:dhi;
+  }
+  { const W scale =(W)(op?op->scale :1.0),
+            offset=(W)(op?op->offset:0.0),
+            lo=(W)dlo,hi=(W)dhi,
+            half=(W)(isint?0.5:0.0);
+    if(ds==sizeof(TD) && ss==sizeof(TS))
+    { TD       * RESTRICT dd=(TD*)d;
+      const TS * RESTRICT sd=(const TS*)s;
+      for(size_t i=0;i<n;++i)
+      { W v=(W)sd[i]*scale+offset;
+        v=(isint && v!=v)?0:v;       // NaN has no integer value
+        v=(v<lo)?lo:v;
+        v=(v>hi)?hi:v;
+        dd[i]=(TD)(v+((v<0)?-half:half));
+      }
+    } else
+    { for(size_t i=0;i<n;++i,d+=ds,s+=ss)
+      { W v=(W)*(const TS*)s*scale+offset;
+        v=(isint && v!=v)?0:v;
+        v=(v<lo)?lo:v;
+        v=(v>hi)?hi:v;
+        *(TD*)d=(TD)(v+((v<0)?-half:half));
+      }
+    }
+  }
+}
+
+/** Plain copy of a row of \a n elements that are each \a bpp bytes. */
+static void copyrow(char *d,size_t ds,const char *s,size_t ss,size_t n,size_t bpp)
+{ if(ds==bpp && ss==bpp)
+  { memcpy(d,s,n*bpp);
+    return;
+  }
+  for(size_t i=0;i<n;++i,d+=ds,s+=ss)
+    memcpy(d,s,bpp);
+}
+
+/** Sum type for statistics: exact integers where they can't overflow, so the loop vectorizes. */
+template<typename T> struct sum_      { typedef f64 type; };
+template<>           struct sum_<u8>  { typedef i64 type; };
+template<>           struct sum_<u16> { typedef i64 type; };
+template<>           struct sum_<u32> { typedef i64 type; };
+template<>           struct sum_<i8>  { typedef i64 type; };
+template<>           struct sum_<i16> { typedef i64 type; };
+template<>           struct sum_<i32> { typedef i64 type; };
+
+/**
+ * Adds one row of \a n elements to \a st.  NaNs are skipped.
+ * Min, max and sum are separate reductions so the contiguous case
+ * vectorizes; the histogram is a second, scalar, loop over the same
+ * (cached) row.  For integer types \c v==v is always true, so the NaN
+ * checks cost nothing there.
+ */
+template<typename T>
+static void stats_row(const char *d,size_t ds,size_t n,xfer_stats_t *st)
+{ typedef typename sum_<T>::type S;
+  T mn=std::numeric_limits<T>::max(),
+    mx=std::numeric_limits<T>::is_integer?std::numeric_limits<T>::min():-std::numeric_limits<T>::max();
+  S sum=0;
+  size_t good=0;
+  if(ds==sizeof(T))
+  { const T * RESTRICT p=(const T*)d;
+    for(size_t i=0;i<n;++i)
+    { const bool ok=(p[i]==p[i]);   // NaN compares false below too
+      mn=(p[i]<mn)?p[i]:mn;
+      mx=(p[i]>mx)?p[i]:mx;
+      sum+=ok?(S)p[i]:(S)0;
+      good+=ok;
+    }
+    if(st->hist)
+    { const double k=st->nbins/(st->hi-st->lo),lo=st->lo;
+      const size_t last=st->nbins-1;
+      for(size_t i=0;i<n;++i)
+      { double b=((double)p[i]-lo)*k;
+        if(b!=b) continue;
+        st->hist[(b<=0)?0:(b>=last)?last:(size_t)b]++;
+      }
+    }
+  } else
+  { for(size_t i=0;i<n;++i)
+    { T v=*(const T*)(d+i*ds);
+      if(v!=v) continue;
+      mn=(v<mn)?v:mn;
+      mx=(v>mx)?v:mx;
+      sum+=(S)v;
+      ++good;
+      if(st->hist)
+      { double b=((double)v-st->lo)*(st->nbins/(st->hi-st->lo));
+        if(b!=b) continue;
+        st->hist[(b<=0)?0:(b>=st->nbins-1)?st->nbins-1:(size_t)b]++;
+      }
+    }
+  }
+  if(!good) return;
+  if(!st->n || mn<st->min) st->min=(double)mn;
+  if(!st->n || mx>st->max) st->max=(double)mx;
+  st->sum+=(double)sum;
+  st->n+=good;
+}
+
+/// @cond DEFINES
+#define CASE2(TD,TS) case nd_##TS: return row<TD,TS>
+#define CASE1(TD) \
+  case nd_##TD: \
+    switch(stype) \
+    { CASE2(TD,u8);  CASE2(TD,u16); CASE2(TD,u32); CASE2(TD,u64); \
+      CASE2(TD,i8);  CASE2(TD,i16); CASE2(TD,i32); CASE2(TD,i64); \
+      CASE2(TD,f32); CASE2(TD,f64); \
+      default: return 0; \
+    }
+/// @endcond
+
+/** \returns the row conversion function for the types, or NULL. */
+static row_t select_row(nd_type_id_t dtype,nd_type_id_t stype)
+{ switch(dtype)
+  { CASE1(u8);  CASE1(u16); CASE1(u32); CASE1(u64);
+    CASE1(i8);  CASE1(i16); CASE1(i32); CASE1(i64);
+    CASE1(f32); CASE1(f64);
+    default: return 0;
+  }
+}
+#undef CASE1
+#undef CASE2
+
+/** \returns the statistics row function for the type, or NULL. */
+static stats_row_t select_stats_row(nd_type_id_t type)
+{ switch(type)
+  { case nd_u8:  return stats_row<u8>;
+    case nd_u16: return stats_row<u16>;
+    case nd_u32: return stats_row<u32>;
+    case nd_u64: return stats_row<u64>;
+    case nd_i8:  return stats_row<i8>;
+    case nd_i16: return stats_row<i16>;
+    case nd_i32: return stats_row<i32>;
+    case nd_i64: return stats_row<i64>;
+    case nd_f32: return stats_row<f32>;
+    case nd_f64: return stats_row<f64>;
+    default: return 0;
+  }
+}
+
+static size_t bytes_per_pixel(nd_type_id_t t)
+{ switch(t)
+  { case nd_u8:  case nd_i8:                return 1;
+    case nd_u16: case nd_i16:               return 2;
+    case nd_u32: case nd_i32: case nd_f32:  return 4;
+    case nd_u64: case nd_i64: case nd_f64:  return 8;
+    default: return 0;
+  }
+}
+
+bool xfer_is_identity(const xfer_op_t *op)
+{ return !op || (op->scale==1.0 && op->offset==0.0 && !op->clamp);
+}
+
+void xfer_stats_init(xfer_stats_t *s, double lo, double hi, unsigned nbins, size_t *hist)
+{ s->min=s->max=s->sum=0.0;
+  s->n=0;
+  s->lo=lo;
+  s->hi=(hi>lo)?hi:lo+1.0;
+  s->nbins=hist?nbins:0;
+  s->hist=(nbins)?hist:0;
+  if(s->hist)
+    memset(s->hist,0,nbins*sizeof(*hist));
+}
+
+void xfer_stats_merge(xfer_stats_t *dst, const xfer_stats_t *src)
+{ if(!src->n) return;
+  if(!dst->n || src->min<dst->min) dst->min=src->min;
+  if(!dst->n || src->max>dst->max) dst->max=src->max;
+  dst->sum+=src->sum;
+  dst->n+=src->n;
+  if(dst->hist && src->hist && dst->nbins==src->nbins)
+    for(unsigned i=0;i<dst->nbins;++i)
+      dst->hist[i]+=src->hist[i];
+}
+
+/**
+ * Walks the outer dimensions, calling the row kernel on dimension 0, and
+ * then \a g, if any, on the row just written.
+ */
+static void xfer_(char *d,const size_t *ds,const char *s,const size_t *ss,
+                  int idim,const size_t *shape,row_t f,size_t bpp,const xfer_op_t *op,
+                  stats_row_t g,xfer_stats_t *st)
+{ if(idim==0)
+  { if(f) f(d,ds[0],s,ss[0],shape[0],op);
+    else  copyrow(d,ds[0],s,ss[0],shape[0],bpp);
+    if(g) g(d,ds[0],shape[0],st);
+    return;
+  }
+  for(size_t i=0;i<shape[idim];++i)
+    xfer_(d+i*ds[idim],ds,s+i*ss[idim],ss,idim-1,shape,f,bpp,op,g,st);
+}
+
+/** Walks the outer dimensions of \a d, calling \a g on each row. */
+static void stats_(const char *d,const size_t *ds,int idim,const size_t *shape,stats_row_t g,xfer_stats_t *st)
+{ if(idim==0)
+  { g(d,ds[0],shape[0],st);
+    return;
+  }
+  for(size_t i=0;i<shape[idim];++i)
+    stats_(d+i*ds[idim],ds,idim-1,shape,g,st);
+}
+
+bool xfer_stats(const void *a, const size_t *strides, nd_type_id_t type,
+                unsigned ndim, const size_t *shape, xfer_stats_t *s)
+{ stats_row_t g=select_stats_row(type);
+  size_t one=1;
+  if(!g) return false;
+  if(ndim==0) stats_((const char*)a,strides,0,&one,g,s);
+  else        stats_((const char*)a,strides,(int)ndim-1,shape,g,s);
+  return true;
+}
+
+bool xfer(void *dst, const size_t *dstrides, nd_type_id_t dtype,
+          const void *src, const size_t *sstrides, nd_type_id_t stype,
+          unsigned ndim, const size_t *shape, const xfer_op_t *op,
+          xfer_stats_t *stats)
+{ row_t f=0;
+  stats_row_t g=0;
+  size_t bpp=bytes_per_pixel(dtype);
+  if(!bpp || !bytes_per_pixel(stype)) return false;
+  if(dtype!=stype || !xfer_is_identity(op))
+    if(!(f=select_row(dtype,stype))) return false;
+  if(stats && !(g=select_stats_row(dtype))) return false;
+  if(ndim==0)
+  { size_t one=1;
+    xfer_((char*)dst,dstrides,(const char*)src,sstrides,0,&one,f,bpp,op,g,stats);
+    return true;
+  }
+  xfer_((char*)dst,dstrides,(const char*)src,sstrides,(int)ndim-1,shape,f,bpp,op,g,stats);
+  return true;
+}
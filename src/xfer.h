@@ -0,0 +1,72 @@
+/**
+ * \file
+ * Strided copies with on-the-fly type conversion.
+ *
+ * Used to move data decoded from a member file into its place in the
+ * caller's array without an intermediate full-size buffer.
+ */
+#ifndef H_NDIO_SERIES_XFER
+#define H_NDIO_SERIES_XFER
+
+#include <stddef.h>
+#include "nd.h"
+
+/**
+ * Element-wise transform: <tt>dst=saturate(clamp(scale*src+offset,lo,hi))</tt>.
+ * The clamp is only applied if \a clamp is non-zero.
+ */
+struct xfer_op_t
+{ double scale,offset,lo,hi;
+  int    clamp;
+};
+
+/**
+ * Running statistics of values, in their own type.
+ *
+ * xfer() updates them from each row it writes, while the row is still in
+ * cache, so collecting them costs no extra pass over the destination.
+ * Partial results, e.g. one per member file, combine with xfer_stats_merge().
+ */
+struct xfer_stats_t
+{ double    min,max,sum;
+  size_t    n;     ///< number of values seen.  NaNs aren't counted anywhere.
+  double    lo,hi; ///< histogram range, [lo,hi).  Values outside it are counted in the end bins.
+  unsigned  nbins;
+  size_t   *hist;  ///< \a nbins counts, or NULL for no histogram
+};
+
+/** Empties \a s.  \a hist, if not NULL, must hold \a nbins counts over [\a lo,\a hi). */
+void xfer_stats_init(xfer_stats_t *s, double lo, double hi, unsigned nbins, size_t *hist);
+
+/** Adds the values counted in \a src to \a dst.  Their histograms must have the same bins. */
+void xfer_stats_merge(xfer_stats_t *dst, const xfer_stats_t *src);
+
+/**
+ * Adds the values of an \a ndim dimensional block of type \a type to \a s.
+ * For data that didn't go through xfer().  Strides are as for xfer().
+ * \returns true on success, false if the type isn't supported.
+ */
+bool xfer_stats(const void *a, const size_t *strides, nd_type_id_t type,
+                unsigned ndim, const size_t *shape, xfer_stats_t *s);
+
+/** \returns true if \a op leaves values unchanged. */
+bool xfer_is_identity(const xfer_op_t *op);
+
+/**
+ * Copy an \a ndim dimensional block of shape \a shape from \a src to \a dst,
+ * converting from \a stype to \a dtype and applying \a op.
+ *
+ * Strides are in bytes, like ndstrides().  The innermost dimension is
+ * dimension 0.  When both arrays are contiguous along dimension 0 the inner
+ * loop is a simple vectorizable loop.
+ *
+ * \param[in] op     May be NULL for a plain (saturating) conversion.
+ * \param[in] stats  If not NULL, the values written to \a dst are added to it.
+ * \returns true on success, false if a type isn't supported.
+ */
+bool xfer(void *dst, const size_t *dstrides, nd_type_id_t dtype,
+          const void *src, const size_t *sstrides, nd_type_id_t stype,
+          unsigned ndim, const size_t *shape, const xfer_op_t *op,
+          xfer_stats_t *stats=0);
+
+#endif //H_NDIO_SERIES_XFER
@@ -0,0 +1,32 @@
+/** \file
+    Testing the checksums kept for member files.
+    @cond TEST
+*/
+
+// solves a std::tuple problem in vs2012
+#define GTEST_HAS_TR1_TUPLE     0
+#define GTEST_USE_OWN_TR1_TUPLE 1
+
+#include <gtest/gtest.h>
+#include "src/hash.h"
+
+TEST(CRC32C,CheckValue)
+{ const char s[]="123456789";
+  EXPECT_EQ(0xE3069283u,crc32c(0,s,9));        // the CPU's instruction, if any
+  EXPECT_EQ(0xE3069283u,crc32c_tables(0,s,9)); // slicing-by-8
+  EXPECT_EQ(0u,crc32c(0,s,0));
+}
+
+TEST(CRC32C,Pieces)
+{ unsigned char buf[1027];
+  uint32_t whole;
+  for(size_t i=0;i<sizeof(buf);++i)
+    buf[i]=(unsigned char)(i*131+7);
+  whole=crc32c_tables(0,buf,sizeof(buf));
+  EXPECT_EQ(whole,crc32c(0,buf,sizeof(buf)));
+  for(size_t n=0;n<=17;++n)          // splits on and off the 8 byte stride
+  { EXPECT_EQ(whole,crc32c(crc32c(0,buf,n),buf+n,sizeof(buf)-n))<<n;
+    EXPECT_EQ(whole,crc32c_tables(crc32c_tables(0,buf,n),buf+n,sizeof(buf)-n))<<n;
+  }
+}
+/// @endcond
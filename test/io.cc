@@ -10,11 +10,30 @@
 #define GTEST_USE_OWN_TR1_TUPLE 1
 
 #include <gtest/gtest.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include "config.h"
 #include "nd.h"
+#include "src/ndio-series.h"
 
 #define countof(e) (sizeof(e)/sizeof(*e))
 
+// the tests run from bin/test in the install tree
+#ifdef _MSC_VER
+#define CONVERT "..\\ndio-series-convert"
+#else
+#define CONVERT "../ndio-series-convert"
+#endif
+
 static
 struct _files_t
 { const char  *path;
@@ -51,6 +70,19 @@ struct Series:public testing::Test
       once=1;
     }
   }
+
+  /**
+   * Removes members 0-19 of a series that earlier runs left behind.
+   * \a fmt names a member from its number, e.g. "T.%d.tif".  Each test
+   * writes under its own prefix, so they don't see each other's members.
+   */
+  static void remove_members(const char *fmt)
+  { for(int z=0;z<20;++z)
+    { char name[64];
+      snprintf(name,sizeof(name),fmt,z);
+      remove(name);
+    }
+  }
 };
 
 TEST_F(Series,OpenClose)
@@ -89,6 +121,48 @@ TEST_F(Series,Shape)
   }
 }
 
+TEST_F(Series,ShapeShared)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0,first=0,second=0;
+  nd_t vol,form;
+  struct utimbuf old={1000,1000};
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  remove_members("U.%d.tif");
+  ndShapeSet(vol,2,4);
+  ASSERT_NE((void*)NULL,file=ndioOpen("U.%.tif",ndioFormat("series"),"w"));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  // Back-date the directory, or its listing is too new to share
+  EXPECT_EQ(0,utime(".",&old));
+  ASSERT_NE((void*)NULL,first=ndioOpen("U.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,form=ndioShape(first))<<ndioError(first);
+  EXPECT_EQ(4u,ndshape(form)[2]);
+  ndfree(form);
+  // A second handle shares the listing, so it misses a member removed
+  // without changing the directory's mtime
+  EXPECT_EQ(0,remove("U.3.tif"));
+  EXPECT_EQ(0,utime(".",&old));
+  ASSERT_NE((void*)NULL,second=ndioOpen("U.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,form=ndioShape(second))<<ndioError(second);
+  EXPECT_EQ(4u,ndshape(form)[2]);
+  ndfree(form);
+  // ...which is listed again once the directory changes: 0-2, then 4 and 5
+  ASSERT_NE((void*)NULL,file=ndioOpen("U.%.tif",ndioFormat("series"),"a"));
+  ndShapeSet(vol,2,2);
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  ASSERT_NE((void*)NULL,form=ndioShape(first))<<ndioError(first);
+  EXPECT_EQ(6u,ndshape(form)[2]);
+  ndfree(form);
+  ndioClose(first);
+  ndioClose(second);
+  ndfree(vol);
+}
+
 TEST_F(Series,Read)
 { struct _files_t *cur;
   for(cur=file_table;cur->path!=NULL;++cur)
@@ -126,6 +200,377 @@ TEST_F(Series,ReadSubarray)
   }
 }
 
+TEST_F(Series,ReadCached)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,win;
+  ndio_series_cache_stats_t before,after;
+  size_t pos[]={0,0,0};
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  // Slide a 3 plane window along z with room for 3 planes in the cache
+  ASSERT_NE((void*)NULL,win=ndioShape(file));
+  ndShapeSet(win,2,3);
+  EXPECT_EQ(win,ndref(win,malloc(ndnbytes(win)),nd_heap));
+  ASSERT_EQ(1u,ndioSeriesCacheBudget(file,ndnbytes(win)));
+  ASSERT_EQ(1u,ndioSeriesCacheStats(file,&before));
+  for(pos[2]=0;pos[2]+3<=10;++pos[2])
+  { ASSERT_EQ(file,ndioReadSubarray(file,win,pos,0))<<ndioError(file);
+    EXPECT_EQ(0,memcmp(nddata(win),(char*)nddata(vol)+pos[2]*ndstrides(vol)[2],ndnbytes(win)))<<"z="<<pos[2];
+  }
+  ASSERT_EQ(1u,ndioSeriesCacheStats(file,&after));
+  EXPECT_EQ(10u,after.misses-before.misses);   // each plane decoded once...
+  EXPECT_EQ(14u,after.hits-before.hits);       // ...and reused while in the window
+  EXPECT_GE(ndnbytes(win),after.bytes);
+  ndioSeriesCacheBudget(file,0);
+  ndfree(win);
+  ndfree(vol);
+  ndioClose(file);
+}
+
+TEST_F(Series,Load)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,dst;
+  size_t focus[]={7},pos[]={0};
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ASSERT_NE((void*)NULL,dst=ndioShape(file));
+  EXPECT_EQ(dst,ndref(dst,calloc(ndnbytes(dst),1),nd_heap));
+  ASSERT_EQ(1u,ndioSeriesLoadBegin(file,dst,focus))<<ndioError(file);
+  ASSERT_EQ(1u,ndioSeriesLoadWait(file,focus,-1));
+  EXPECT_EQ(0,memcmp((char*)nddata(vol)+7*ndstrides(vol)[2],(char*)nddata(dst)+7*ndstrides(dst)[2],ndstrides(vol)[2]));
+  ASSERT_EQ(1u,ndioSeriesLoadFocus(file,pos));
+  ASSERT_EQ(1u,ndioSeriesLoadWait(file,0,-1));
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(dst),ndnbytes(vol)));
+  pos[0]=10;                             // past the end
+  EXPECT_EQ(0u,ndioSeriesLoadWait(file,pos,0));
+  ndioSeriesLoadCancel(file);
+  EXPECT_EQ(0u,ndioSeriesLoadWait(file,0,0));
+  ndfree(dst);
+  ndfree(vol);
+  ndioClose(file);
+}
+
+TEST_F(Series,ReadThreads)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t one,many;
+  ndio_series_params_t params;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL, one=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+  ASSERT_NE((void*)NULL,many=ndioShape(file));
+  EXPECT_EQ(one,ndref(one,malloc(ndnbytes(one)),nd_heap));
+  EXPECT_EQ(many,ndref(many,malloc(ndnbytes(many)),nd_heap));
+  // One member at a time...
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.threads=1;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(1u,ndioSeriesConcurrency(file));
+  EXPECT_EQ(file,ndioRead(file,one))<<ndioError(file);
+  // ...and tuned
+  params.threads=0;
+  params.max_threads=4;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(file,ndioRead(file,many))<<ndioError(file);
+  EXPECT_LE(1u,ndioSeriesConcurrency(file));
+  EXPECT_GE(4u,ndioSeriesConcurrency(file));
+  EXPECT_EQ(0,memcmp(nddata(one),nddata(many),ndnbytes(one)));
+  ndfree(many);
+  ndfree(one);
+  ndioClose(file);
+}
+
+TEST_F(Series,Partition)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,part;
+  size_t origin[3],shape[3],next=0;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  // Three workers cover the series between them, in order
+  for(unsigned rank=0;rank<3;++rank)
+  { ASSERT_EQ(1u,ndioSeriesPartition(file,rank,3,origin,shape))<<ndioError(file);
+    EXPECT_EQ(0u,origin[0]);
+    EXPECT_EQ(ndshape(vol)[0],shape[0]);
+    EXPECT_EQ(next,origin[2]);
+    EXPECT_LE(3u,shape[2]);            // equal sized planes split 3/3/4 or so
+    ASSERT_NE((void*)NULL,part=ndioShape(file));
+    ndShapeSet(part,2,shape[2]);
+    EXPECT_EQ(part,ndref(part,malloc(ndnbytes(part)),nd_heap));
+    ASSERT_EQ(file,ndioReadSubarray(file,part,origin,0))<<ndioError(file);
+    EXPECT_EQ(0,memcmp(nddata(part),(char*)nddata(vol)+origin[2]*ndstrides(vol)[2],ndnbytes(part)));
+    ndfree(part);
+    next=origin[2]+shape[2];
+  }
+  EXPECT_EQ(ndshape(vol)[2],next);
+  EXPECT_EQ(0u,ndioSeriesPartition(file,3,3,origin,shape));
+  ndfree(vol);
+  ndioClose(file);
+}
+
+TEST_F(Series,PartitionResized)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol;
+  size_t origin[3],shape[3];
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  remove_members("E.%d.tif");
+  remove(".E.%.tif.ndio-series-sizes");
+  ASSERT_NE((void*)NULL,file=ndioOpen("E.%.tif",ndioFormat("series"),"w"));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  ASSERT_NE((void*)NULL,file=ndioOpen("E.%.tif",ndioFormat("series"),"r"));
+  ASSERT_EQ(1u,ndioSeriesPartition(file,1,2,origin,shape))<<ndioError(file);
+  EXPECT_EQ(5u,origin[2]);
+  ndioClose(file);
+  // The last member grows to outweigh the rest; the sidecar mustn't hide that
+  { FILE *fp;
+    void *junk=calloc(1,ndnbytes(vol));
+    ASSERT_NE((void*)NULL,fp=fopen("E.9.tif","ab"));
+    fwrite(junk,1,ndnbytes(vol),fp);
+    fclose(fp);
+    free(junk);
+  }
+  ASSERT_NE((void*)NULL,file=ndioOpen("E.%.tif",ndioFormat("series"),"r"));
+  ASSERT_EQ(1u,ndioSeriesPartition(file,1,2,origin,shape))<<ndioError(file);
+  EXPECT_EQ(9u,origin[2]);
+  EXPECT_EQ(1u,shape[2]);
+  ndioClose(file);
+  remove_members("E.%d.tif");
+  remove(".E.%.tif.ndio-series-sizes");
+  ndfree(vol);
+}
+
+TEST_F(Series,ReadStats)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10, u16
+  ndio_t file=0;
+  nd_t vol;
+  ndio_series_params_t params;
+  ndio_series_stats_t all;
+  const ndio_series_stats_t *planes;
+  size_t hist[NDIO_SERIES_HIST_BINS],nplanes,total=0;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.stats=1;
+  params.hist_lo=1;                  // an empty histogram range is refused
+  EXPECT_EQ(NULL,ndioSet(file,&params,sizeof(params)));
+  params.hist_lo=0;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(file,ndioRead(file,vol))<<ndioError(file);
+  ASSERT_NE((void*)NULL,planes=ndioSeriesStats(file,&all,hist,&nplanes));
+  ASSERT_EQ(ndshape(vol)[2],nplanes);
+  // Compare with a pass over each plane
+  { const size_t n=ndstrides(vol)[2]/sizeof(unsigned short);
+    for(size_t z=0;z<nplanes;++z)
+    { const unsigned short *p=(const unsigned short*)nddata(vol)+z*n;
+      unsigned short mn=p[0],mx=p[0];
+      double sum=0.0;
+      for(size_t i=0;i<n;++i)
+      { mn=(p[i]<mn)?p[i]:mn;
+        mx=(p[i]>mx)?p[i]:mx;
+        sum+=p[i];
+      }
+      EXPECT_EQ(n,planes[z].count)<<"z="<<z;
+      EXPECT_EQ((double)mn,planes[z].min)<<"z="<<z;
+      EXPECT_EQ((double)mx,planes[z].max)<<"z="<<z;
+      EXPECT_NEAR(sum/n,planes[z].mean,1e-6)<<"z="<<z;
+    }
+  }
+  for(size_t i=0;i<NDIO_SERIES_HIST_BINS;++i)
+    total+=hist[i];
+  EXPECT_EQ(ndnelem(vol),all.count);
+  EXPECT_EQ(ndnelem(vol),total);
+  ndfree(vol);
+  ndioClose(file);
+}
+
+struct progress_log_t
+{ size_t calls,stop;
+  ndio_series_progress_t last;
+};
+static int log_progress(const ndio_series_progress_t *progress, void *user)
+{ progress_log_t *log=(progress_log_t*)user;
+  ++log->calls;
+  log->last=*progress;
+  return (log->stop && progress->done>=log->stop)?NDIO_SERIES_CANCEL:NDIO_SERIES_CONTINUE;
+}
+
+TEST_F(Series,Progress)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol;
+  ndio_series_params_t params;
+  progress_log_t log={};
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.threads=1;                  // so the cancel lands on a known member
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  ASSERT_EQ(1u,ndioSeriesProgress(file,log_progress,&log));
+  EXPECT_EQ(file,ndioRead(file,vol))<<ndioError(file);
+  EXPECT_EQ(10u,log.calls);
+  EXPECT_EQ(10u,log.last.done);
+  EXPECT_EQ(10u,log.last.total);
+  EXPECT_EQ(ndnbytes(vol),log.last.bytes);
+  // Cancel part way
+  log.calls=0;
+  log.stop=3;
+  EXPECT_EQ(NULL,ndioRead(file,vol));
+  EXPECT_EQ(3u,log.calls);
+  // ...and carry on without the callback
+  ndioSeriesProgress(file,NULL,NULL);
+  EXPECT_EQ(file,ndioRead(file,vol))<<ndioError(file);
+  // Cancel with several members read at once.  The callback isn't called
+  // again once it's cancelled.
+  params.threads=4;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  ASSERT_EQ(1u,ndioSeriesProgress(file,log_progress,&log));
+  log.calls=0;
+  EXPECT_EQ(NULL,ndioRead(file,vol));
+  EXPECT_EQ(3u,log.calls);
+  ndioClose(file);
+  // ...and written at once, which stops before the last member
+  remove_members("H.%d.tif");
+  ASSERT_NE((void*)NULL,file=ndioOpen("H.%.tif",ndioFormat("series"),"w"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.threads=4;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  ASSERT_EQ(1u,ndioSeriesProgress(file,log_progress,&log));
+  log.calls=0;
+  EXPECT_EQ(NULL,ndioWrite(file,vol));
+  EXPECT_EQ(3u,log.calls);
+  ndioClose(file);
+  { struct stat st;
+    size_t n=0;
+    for(int z=0;z<10;++z)
+    { char name[64];
+      snprintf(name,sizeof(name),"H.%d.tif",z);
+      n+=(stat(name,&st)==0);
+    }
+    EXPECT_LE(3u,n);
+    EXPECT_GT(10u,n);
+  }
+  ndfree(vol);
+}
+
+TEST_F(Series,ReadConvert)
+{ struct _files_t *cur=file_table; // Set A: u16
+  ndio_t file=0;
+  nd_t vol,fvol;
+  ndio_series_params_t params;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+  ASSERT_NE((void*)NULL,fvol=ndioShape(file));
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  EXPECT_EQ(file,ndioRead(file,vol));
+  // Read again as floats, scaled to [0,1]
+  EXPECT_EQ(fvol,ndref(ndcast(fvol,nd_f32),malloc(ndnbytes(fvol)),nd_heap));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.scale=1.0/65535.0;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(file,ndioRead(file,fvol))<<ndioError(file);
+  { unsigned short *a=(unsigned short*)nddata(vol);
+    float *b=(float*)nddata(fvol);
+    for(size_t i=0;i<ndnelem(vol);++i)
+      ASSERT_FLOAT_EQ(a[i]/65535.0f,b[i])<<i;
+  }
+  ndfree(fvol);
+  ndfree(vol);
+  ndioClose(file);
+}
+
+TEST_F(Series,ReadDims)
+{ struct _files_t *cur=file_table+1; // Set B: 620x512x2x16
+  ndio_t file=0;
+  nd_t vol,ivol;
+  ndio_series_params_t params;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  // Read again with colors interleaved innermost
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.dims[0]=0;
+  params.dims[1]=3;
+  ASSERT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  ASSERT_NE((void*)NULL,ivol=ndioShape(file))<<ndioError(file);
+  ASSERT_EQ(4u,ndndim(ivol));
+  EXPECT_EQ(2u,ndshape(ivol)[0]);
+  EXPECT_EQ(620u,ndshape(ivol)[1]);
+  EXPECT_EQ(16u,ndshape(ivol)[3]);
+  EXPECT_EQ(ivol,ndref(ivol,malloc(ndnbytes(ivol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,ivol));
+  { const unsigned char *a=(unsigned char*)nddata(vol),
+                        *b=(unsigned char*)nddata(ivol);
+    const size_t np=620*512;
+    for(size_t z=0;z<16;++z)
+      for(size_t c=0;c<2;++c)
+        for(size_t i=0;i<np;++i)
+          ASSERT_EQ(a[i+np*(c+2*z)],b[c+2*(i+np*z)])<<"c="<<c<<" z="<<z<<" i="<<i;
+  }
+  ndfree(ivol);
+  ndfree(vol);
+  ndioClose(file);
+}
+
+TEST_F(Series,ReadCompact)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,plane,svol;
+  ndio_series_params_t params;
+  const size_t number[]={0,1000,2000};
+  size_t n;
+  const size_t *labels;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  // Write three planes with sparse numbers
+  ASSERT_NE((void*)NULL,plane=ndinit());
+  ndreshape(ndcast(plane,ndtype(vol)),2,ndshape(vol));
+  for(size_t i=0;i<countof(number);++i)
+  { char name[64];
+    snprintf(name,sizeof(name),"S.%d.tif",(int)number[i]);
+    ndref(plane,(char*)nddata(vol)+i*ndstrides(vol)[2],nd_static);
+    ASSERT_NE((void*)NULL,file=ndioOpen(name,NULL,"w"));
+    EXPECT_EQ(file,ndioWrite(file,plane));
+    ndioClose(file);
+  }
+  ndfree(plane);
+  // The series is 3 planes, not 2001
+  ASSERT_NE((void*)NULL,file=ndioOpen("S.%.tif",ndioFormat("series"),"r"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.compact=1;
+  ASSERT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  ASSERT_NE((void*)NULL,svol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(3u,ndshape(svol)[2]);
+  ASSERT_NE((void*)NULL,labels=ndioSeriesLabels(file,0,&n));
+  ASSERT_EQ(3u,n);
+  for(size_t i=0;i<n;++i)
+    EXPECT_EQ(number[i],labels[i]);
+  EXPECT_EQ(svol,ndref(svol,malloc(ndnbytes(svol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,svol));
+  EXPECT_EQ(0,memcmp(nddata(svol),nddata(vol),ndnbytes(svol)));
+  ndioClose(file);
+  ndfree(svol);
+  ndfree(vol);
+}
+
 TEST_F(Series,Write)
 {
   nd_t vol;
@@ -139,26 +584,644 @@ TEST_F(Series,Write)
     ndioClose(file);
   }
 
-#if 1
-  // Transpose colors to last dimension
-  { nd_t dst=ndinit();
-    ndref(dst,malloc(ndnbytes(vol)),nd_heap);
-    ndreshape(ndcast(dst,ndtype(vol)),ndndim(vol),ndshape(vol));
-    EXPECT_EQ(dst,ndtranspose(dst,vol,2,3,0,NULL));
-    // Cleanup vol
-    ndfree(vol);
-    vol=dst; // Carry the array out of scope
-  }
-#endif
-
-  // Write
+  // Write colors as the series, without transposing them to the last dimension
   { ndio_t file=0;
+    ndio_series_params_t params;
     EXPECT_NE((void*)NULL,file=ndioOpen("B.%.tif",ndioFormat("series"),"w"));
+    params=((ndio_series_t*)ndioGet(file))->params;
+    params.dims[0]=2;
+    EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
     EXPECT_NE((void*)NULL,ndioWrite(file,vol));
     ndioClose(file);
   }
+  // Each member holds one color
+  { ndio_t file=0;
+    nd_t plane;
+    EXPECT_NE((void*)NULL,file=ndioOpen("B.1.tif",NULL,"r"));
+    ASSERT_NE((void*)NULL,plane=ndioShape(file))<<ndioError(file);
+    ASSERT_EQ(3u,ndndim(plane));
+    EXPECT_EQ(ndshape(vol)[3],ndshape(plane)[2]);
+    EXPECT_EQ(plane,ndref(plane,malloc(ndnbytes(plane)),nd_heap));
+    ASSERT_EQ(file,ndioRead(file,plane));
+    EXPECT_EQ(0,memcmp(nddata(plane),(char*)nddata(vol)+ndstrides(vol)[2],ndstrides(vol)[2]))
+      <<"First plane of color 1 differs";
+    ndfree(plane);
+    ndioClose(file);
+  }
 
   // Cleanup
   ndfree(vol);
 }
+TEST_F(Series,WriteWidth)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,plane;
+  struct stat st;
+  size_t pos[]={0,0,7};
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  remove_members("Z.%03d.tif");
+  ASSERT_NE((void*)NULL,file=ndioOpen("Z.%03.tif",ndioFormat("series"),"w"));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  EXPECT_EQ(0,stat("Z.000.tif",&st));
+  EXPECT_EQ(0,stat("Z.009.tif",&st));
+  // The width is inferred from an example name
+  ASSERT_NE((void*)NULL,file=ndioOpen("Z.000.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,plane=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(10u,ndshape(plane)[2]);
+  ndShapeSet(plane,2,1);
+  EXPECT_EQ(plane,ndref(plane,malloc(ndnbytes(plane)),nd_heap));
+  ASSERT_EQ(file,ndioReadSubarray(file,plane,pos,0))<<ndioError(file);
+  EXPECT_EQ(0,memcmp(nddata(plane),(char*)nddata(vol)+7*ndstrides(vol)[2],ndnbytes(plane)));
+  ndioClose(file);
+  ndfree(plane);
+  // A field without a width finds the padded names too
+  ASSERT_NE((void*)NULL,file=ndioOpen("Z.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,plane=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(10u,ndshape(plane)[2]);
+  ndfree(plane);
+  ndioClose(file);
+  ndfree(vol);
+}
+
+#ifndef _MSC_VER
+TEST_F(Series,WriteStriped)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,vol2;
+  ndio_series_params_t params;
+  struct stat st;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  mkdir("stripe0",0777);
+  mkdir("stripe1",0777);
+  // Round robin over two roots
+  ASSERT_NE((void*)NULL,file=ndioOpen("R.%.tif",ndioFormat("series"),"w"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.roots="stripe0:stripe1";
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  EXPECT_EQ(0,stat("stripe0/R.4.tif",&st));
+  EXPECT_EQ(0,stat("stripe1/R.5.tif",&st));
+  EXPECT_NE(0,stat("stripe1/R.4.tif",&st));
+  // Read back from both
+  ASSERT_NE((void*)NULL,file=ndioOpen("R.%.tif",ndioFormat("series"),"r"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.roots="stripe0:stripe1";
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  ASSERT_NE((void*)NULL,vol2=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(10u,ndshape(vol2)[2]);
+  EXPECT_EQ(vol2,ndref(vol2,malloc(ndnbytes(vol2)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol2));
+  ndioClose(file);
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(vol2),ndnbytes(vol)));
+  ndfree(vol2);
+  // Each stripe is a series on its own: planes 1,3,...,9
+  ASSERT_NE((void*)NULL,file=ndioOpen("stripe1/R.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol2=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(9u,ndshape(vol2)[2]);
+  ndfree(vol2);
+  ndioClose(file);
+  ndfree(vol);
+}
+#endif
+
+TEST_F(Series,Append)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,vol2;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  remove_members("T.%d.tif");
+  // Write the first 4 planes
+  ndShapeSet(vol,2,4);
+  ASSERT_NE((void*)NULL,file=ndioOpen("T.%.tif",ndioFormat("series"),"w"));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  // Reopen and append the rest, in two writes
+  ASSERT_NE((void*)NULL,file=ndioOpen("T.%.tif",ndioFormat("series"),"a"));
+  ndoffset(vol,2,4);
+  ndShapeSet(vol,2,3);
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndoffset(vol,2,3);
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  ndoffset(vol,2,-7);
+  ndShapeSet(vol,2,10);
+  // Should read back as the whole volume
+  ASSERT_NE((void*)NULL,file=ndioOpen("T.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol2=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(10u,ndshape(vol2)[2]);
+  EXPECT_EQ(vol2,ndref(vol2,malloc(ndnbytes(vol2)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol2));
+  ndioClose(file);
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(vol2),ndnbytes(vol)));
+  ndfree(vol2);
+  ndfree(vol);
+}
+TEST_F(Series,WriteAsync)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,vol2;
+  ndio_series_params_t params;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  remove_members("Q.%d.tif");
+  // Append one plane at a time with room for two in the queue
+  ASSERT_NE((void*)NULL,file=ndioOpen("Q.%.tif",ndioFormat("series"),"a"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.async=1;
+  params.queue_budget=2*620*512*2;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  ndShapeSet(vol,2,1);
+  for(size_t z=0;z<10;++z)
+  { EXPECT_EQ(file,ndioWrite(file,vol))<<"z="<<z;
+    memset(nddata(vol),0,ndnbytes(vol)); // the series made its own copy
+    ndoffset(vol,2,1);
+  }
+  ndoffset(vol,2,-10);
+  ndShapeSet(vol,2,10);
+  EXPECT_EQ(1u,ndioSeriesFlush(file));
+  ndioClose(file);
+  // Reread the source, since it was overwritten
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  ASSERT_NE((void*)NULL,file=ndioOpen("Q.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol2=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(10u,ndshape(vol2)[2]);
+  EXPECT_EQ(vol2,ndref(vol2,malloc(ndnbytes(vol2)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol2));
+  ndioClose(file);
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(vol2),ndnbytes(vol)));
+  ndfree(vol2);
+  ndfree(vol);
+}
+TEST_F(Series,WriteSubarray)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,vol2,block;
+  void *buf;
+  ndio_series_params_t params;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  // Write in blocks of 100 rows, so every plane is assembled from several
+  // blocks.  The budget only holds one plane at a time.
+  ASSERT_NE((void*)NULL,file=ndioOpen("P.%.tif",ndioFormat("series"),"w"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.write_budget=620*512*2;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  ASSERT_NE((void*)NULL,block=ndinit());
+  ASSERT_NE((void*)NULL,buf=malloc(620*100*10*ndbpp(vol)));
+  for(size_t y=0;y<512;y+=100)
+  { size_t origin[]={0,y,0},
+           shape[]={620,(y+100<=512)?100:512-y,10};
+    ndreshape(ndcast(block,ndtype(vol)),3,shape);
+    ndref(block,buf,nd_static);
+    for(size_t z=0;z<10;++z)
+      memcpy((char*)nddata(block)+z*ndstrides(block)[2],
+             (char*)nddata(vol)+z*ndstrides(vol)[2]+y*ndstrides(vol)[1],
+             ndstrides(block)[2]);
+    EXPECT_EQ(1u,ndioSeriesWriteSubarray(file,block,origin,ndshape(vol)))<<"y="<<y;
+  }
+  ndfree(block);
+  free(buf);
+  EXPECT_EQ(1u,ndioSeriesFlush(file));
+  ndioClose(file);
+  // Read it back
+  ASSERT_NE((void*)NULL,file=ndioOpen("P.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol2=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol2,ndref(vol2,malloc(ndnbytes(vol2)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol2));
+  ndioClose(file);
+  ASSERT_EQ(ndnbytes(vol),ndnbytes(vol2));
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(vol2),ndnbytes(vol)));
+  ndfree(vol2);
+  ndfree(vol);
+}
+TEST_F(Series,WriteIncremental)
+{ nd_t vol;
+  ndio_t file=0;
+  ndio_series_params_t params;
+  struct utimbuf old={1000,1000};
+  struct stat st;
+  // Read data set B
+  { struct _files_t *cur=file_table+1;
+    EXPECT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+    ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+    EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+    ASSERT_EQ(file,ndioRead(file,vol));
+    ndioClose(file);
+  }
+  // Write everything once
+  ASSERT_NE((void*)NULL,file=ndioOpen("C.%.%.tif",ndioFormat("series"),"w"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.incremental=1;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  // Back-date the member files, then change one plane and write again
+  for(size_t c=0;c<2;++c)
+    for(size_t z=0;z<16;++z)
+    { char name[64];
+      snprintf(name,sizeof(name),"C.%d.%d.tif",(int)c,(int)z);
+      EXPECT_EQ(0,utime(name,&old))<<name;
+    }
+  ((unsigned char*)nddata(vol))[ndstrides(vol)[3]*5]+=1; // first pixel of plane (c=0,z=5)
+  ASSERT_NE((void*)NULL,file=ndioOpen("C.%.%.tif",ndioFormat("series"),"w"));
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  // Only the changed plane should have been rewritten
+  ASSERT_EQ(0,stat("C.0.5.tif",&st));
+  EXPECT_NE(1000,st.st_mtime);
+  ASSERT_EQ(0,stat("C.0.4.tif",&st));
+  EXPECT_EQ(1000,st.st_mtime);
+  ASSERT_EQ(0,stat("C.1.5.tif",&st));
+  EXPECT_EQ(1000,st.st_mtime);
+  ndfree(vol);
+}
+TEST_F(Series,WriteDurable)
+{ nd_t vol,vol2;
+  ndio_t file=0;
+  ndio_series_params_t params;
+  struct stat st;
+  // Read data set B
+  { struct _files_t *cur=file_table+1;
+    EXPECT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+    ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+    EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+    ASSERT_EQ(file,ndioRead(file,vol));
+    ndioClose(file);
+  }
+  // Write in batches that don't divide the number of files
+  ASSERT_NE((void*)NULL,file=ndioOpen("D.%.%.tif",ndioFormat("series"),"w"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.durable=1;
+  params.batch=5;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  // Every member is in place and no temporaries are left behind
+  EXPECT_EQ(0,stat("D.1.15.tif",&st));
+  EXPECT_NE(0,stat(".~D.1.15.tif",&st));
+  EXPECT_NE(0,stat(".~D.0.0.tif",&st));
+  // Read it back
+  ASSERT_NE((void*)NULL,file=ndioOpen("D.%.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol2=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol2,ndref(vol2,malloc(ndnbytes(vol2)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol2));
+  ndioClose(file);
+  ASSERT_EQ(ndnbytes(vol),ndnbytes(vol2));
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(vol2),ndnbytes(vol)));
+  ndfree(vol2);
+  ndfree(vol);
+}
+TEST_F(Series,WriteChecksum)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol;
+  ndio_series_params_t params;
+  FILE *fp;
+  int c;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  ASSERT_NE((void*)NULL,file=ndioOpen("V.%.tif",ndioFormat("series"),"w"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.checksum=1;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  // Intact files verify
+  ASSERT_NE((void*)NULL,file=ndioOpen("V.%.tif",ndioFormat("series"),"r"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.verify=1;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(file,ndioRead(file,vol))<<ndioError(file);
+  // Flip one pixel byte in the middle of a member file
+  ASSERT_NE((void*)NULL,fp=fopen("V.3.tif","r+b"));
+  fseek(fp,0,SEEK_END);
+  fseek(fp,ftell(fp)/2,SEEK_SET);
+  c=fgetc(fp);
+  fseek(fp,-1,SEEK_CUR);
+  fputc(c^0xff,fp);
+  fclose(fp);
+  EXPECT_EQ(NULL,ndioRead(file,vol));
+  ndioClose(file);
+  ndfree(vol);
+}
+TEST_F(Series,WritePack)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,vol2,sub;
+  ndio_series_params_t params;
+  struct stat st;
+  size_t pos[]={100,200,3},subshape[]={3,2,2};
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  remove("K.%.tif.pack");
+  ASSERT_NE((void*)NULL,file=ndioOpen("K.%.tif",ndioFormat("series"),"w"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.pack=1;
+  params.durable=1;                  // packs can't be written durably
+  EXPECT_EQ(NULL,ndioSet(file,&params,sizeof(params)));
+  params.durable=0;
+  EXPECT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  EXPECT_EQ(0,stat("K.%.tif.pack",&st));
+  EXPECT_NE(0,stat("K.0.tif",&st));  // no member files
+  // Read it all back
+  ASSERT_NE((void*)NULL,file=ndioOpen("K.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol2=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(10u,ndshape(vol2)[2]);
+  EXPECT_EQ(vol2,ndref(vol2,malloc(ndnbytes(vol2)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol2));
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(vol2),ndnbytes(vol)));
+  // ...and a sub-array
+  ASSERT_NE((void*)NULL,sub=ndinit());
+  ndreshape(ndcast(sub,ndtype(vol)),3,subshape);
+  EXPECT_EQ(sub,ndref(sub,malloc(ndnbytes(sub)),nd_heap));
+  ASSERT_EQ(file,ndioReadSubarray(file,sub,pos,0))<<ndioError(file);
+  ndioClose(file);
+  for(size_t z=0;z<2;++z)
+    for(size_t y=0;y<2;++y)
+      EXPECT_EQ(0,memcmp((char*)nddata(sub)+y*ndstrides(sub)[1]+z*ndstrides(sub)[2],
+                         (char*)nddata(vol)+pos[0]*ndstrides(vol)[0]+(pos[1]+y)*ndstrides(vol)[1]+(pos[2]+z)*ndstrides(vol)[2],
+                         3*ndstrides(sub)[0]))<<"y="<<y<<" z="<<z;
+  ndfree(sub);
+  // A torn append leaves junk after the last footer; the old index still reads
+  { FILE *fp;
+    char junk[4096];
+    memset(junk,'x',sizeof(junk));
+    memcpy(junk+100,"NDPACK01",8);
+    ASSERT_NE((void*)NULL,fp=fopen("K.%.tif.pack","ab"));
+    fwrite(junk,1,sizeof(junk),fp);
+    fclose(fp);
+  }
+  ASSERT_NE((void*)NULL,file=ndioOpen("K.%.tif",ndioFormat("series"),"r"));
+  memset(nddata(vol2),0,ndnbytes(vol2));
+  ASSERT_EQ(file,ndioRead(file,vol2))<<ndioError(file);
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(vol2),ndnbytes(vol)));
+  ndioClose(file);
+  ndfree(vol2);
+  ndfree(vol);
+}
+
+TEST_F(Series,Slabs)
+{ struct _files_t *cur=file_table+1; // Set B: 620x512x2x16
+  ndio_t file=0;
+  nd_t vol,slab;
+  size_t n=0,shape[]={2,5},origin[4];
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  // Budget for a single 620x512x2x5 slab: too small for double buffering,
+  // but enough to iterate.
+  EXPECT_EQ(0,ndioSeriesSlabBegin(file,shape,620*512*2*5-1));
+  ASSERT_EQ(1,ndioSeriesSlabBegin(file,shape,620*512*2*5));
+  while(ndioSeriesSlabNext(file,&slab,origin))
+  { EXPECT_EQ(0u,origin[2]);
+    EXPECT_EQ(5*n,origin[3]);
+    EXPECT_EQ((n<3)?5u:1u,ndshape(slab)[3]);
+    EXPECT_EQ(0,memcmp(nddata(slab),(char*)nddata(vol)+origin[3]*ndstrides(vol)[3],ndnbytes(slab)));
+    ++n;
+  }
+  EXPECT_EQ(4u,n);
+  ndioSeriesSlabEnd(file);
+  ndfree(vol);
+  ndioClose(file);
+}
+
+TEST_F(Series,Convert)
+{ struct _files_t *cur=file_table; // Set A: 620x512x10
+  ndio_t file=0;
+  nd_t vol,out,form;
+  char cmd[1024];
+  const size_t plane=620*512*2;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,vol=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  ndioClose(file);
+  remove_members("G.%d.tif");
+  // 3 planes to a member, read in 3 plane slabs by 2 threads
+  snprintf(cmd,sizeof(cmd),CONVERT " -g 3 -m 1 -t 2 \"%s\" G.%%.tif",cur->path);
+  ASSERT_EQ(0,system(cmd))<<cmd;
+  ASSERT_NE((void*)NULL,file=ndioOpen("G.3.tif",NULL,"r"));   // the short last member
+  ASSERT_NE((void*)NULL,form=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(1u,(ndndim(form)>2)?ndshape(form)[2]:1u);
+  ndfree(form);
+  ndioClose(file);
+  ASSERT_NE((void*)NULL,file=ndioOpen("G.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,out=ndioShape(file))<<ndioError(file);
+  ASSERT_EQ(4u,ndndim(out));
+  EXPECT_EQ(3u,ndshape(out)[2]);
+  EXPECT_EQ(4u,ndshape(out)[3]);
+  EXPECT_EQ(out,ndref(out,calloc(ndnbytes(out),1),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,out));
+  ndioClose(file);
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(out),ndnbytes(vol)));
+  for(size_t i=ndnbytes(vol);i<ndnbytes(out);++i) // padding after the short member
+    ASSERT_EQ(0,((char*)nddata(out))[i])<<i;
+  ndfree(out);
+  // Converting again appends members 4-7
+  ASSERT_EQ(0,system(cmd))<<cmd;
+  ASSERT_NE((void*)NULL,file=ndioOpen("G.%.tif",ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL,out=ndioShape(file))<<ndioError(file);
+  EXPECT_EQ(8u,ndshape(out)[3]);
+  EXPECT_EQ(out,ndref(out,calloc(ndnbytes(out),1),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,out));
+  ndioClose(file);
+  EXPECT_EQ(0,memcmp(nddata(vol),(char*)nddata(out)+12*plane,ndnbytes(vol)));
+  ndfree(out);
+  ndfree(vol);
+}
+
+#ifdef __linux__
+TEST_F(Series,Map)
+{ struct _files_t *cur=file_table+1; // Set B: 620x512x2x16
+  ndio_t file=0;
+  nd_t vol,map;
+  ASSERT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+  ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+  EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+  ASSERT_EQ(file,ndioRead(file,vol));
+  // Room for two members, so touching everything evicts
+  ASSERT_NE((void*)NULL,map=ndioSeriesMap(file,0));
+  EXPECT_EQ(ndtype(vol),ndtype(map));
+  ASSERT_EQ(ndnbytes(vol),ndnbytes(map));
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(map),ndnbytes(vol)));
+  // ...and the start was dropped, so this reads it in again
+  EXPECT_EQ(0,memcmp(nddata(vol),nddata(map),ndstrides(vol)[3]));
+  ndioSeriesUnmap(file);
+  ndfree(vol);
+  ndioClose(file);
+}
+
+TEST_F(Series,Watch)
+{ nd_t vol,form;
+  ndio_t file=0,reader=0;
+  ndio_series_params_t params;
+  // Read data set A
+  { struct _files_t *cur=file_table;
+    EXPECT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+    ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+    EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+    ASSERT_EQ(file,ndioRead(file,vol));
+    ndioClose(file);
+  }
+  // Start with the first 4 planes
+  remove_members("W.%d.tif");
+  ndShapeSet(vol,2,4);
+  ASSERT_NE((void*)NULL,file=ndioOpen("W.%.tif",ndioFormat("series"),"w"));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  ASSERT_NE((void*)NULL,reader=ndioOpen("W.%.tif",ndioFormat("series"),"r"));
+  params=((ndio_series_t*)ndioGet(reader))->params;
+  params.watch=1;
+  ASSERT_EQ(reader,ndioSet(reader,&params,sizeof(params)));
+  ASSERT_NE((void*)NULL,form=ndioShape(reader));
+  EXPECT_EQ(4u,ndshape(form)[2]);
+  ndfree(form);
+  // Write all 8; the reader should see the new ones without reopening
+  ndShapeSet(vol,2,8);
+  ASSERT_NE((void*)NULL,file=ndioOpen("W.%.tif",ndioFormat("series"),"w"));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  ASSERT_NE((void*)NULL,form=ndioShape(reader));
+  EXPECT_EQ(8u,ndshape(form)[2]);
+  ndfree(form);
+  ndioClose(reader);
+  ndfree(vol);
+}
+
+TEST_F(Series,WatchOpenMember)
+{ nd_t vol,form;
+  ndio_t file=0,reader=0;
+  ndio_series_params_t params;
+  FILE *fp;
+  char *buf;
+  long n;
+  // Read data set A
+  { struct _files_t *cur=file_table;
+    EXPECT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+    ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+    EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+    ASSERT_EQ(file,ndioRead(file,vol));
+    ndioClose(file);
+  }
+  remove_members("J.%d.tif");
+  ndShapeSet(vol,2,4);
+  ASSERT_NE((void*)NULL,file=ndioOpen("J.%.tif",ndioFormat("series"),"w"));
+  EXPECT_EQ(file,ndioWrite(file,vol));
+  ndioClose(file);
+  // J.4.tif is a copy of J.3.tif that's half written when the watch starts
+  ASSERT_NE((void*)NULL,fp=fopen("J.3.tif","rb"));
+  fseek(fp,0,SEEK_END);
+  n=ftell(fp);
+  rewind(fp);
+  ASSERT_NE((void*)NULL,buf=(char*)malloc(n));
+  ASSERT_EQ((size_t)n,fread(buf,1,n,fp));
+  fclose(fp);
+  ASSERT_NE((void*)NULL,fp=fopen("J.4.tif","wb"));
+  fwrite(buf,1,n/2,fp);
+  fflush(fp);
+  ASSERT_NE((void*)NULL,reader=ndioOpen("J.%.tif",ndioFormat("series"),"r"));
+  params=((ndio_series_t*)ndioGet(reader))->params;
+  params.watch=1;
+  ASSERT_EQ(reader,ndioSet(reader,&params,sizeof(params)));
+  ASSERT_NE((void*)NULL,form=ndioShape(reader));
+  EXPECT_EQ(4u,ndshape(form)[2]);
+  ndfree(form);
+  // ...and shows up once it's closed
+  fwrite(buf+n/2,1,n-n/2,fp);
+  fclose(fp);
+  free(buf);
+  ASSERT_NE((void*)NULL,form=ndioShape(reader));
+  EXPECT_EQ(5u,ndshape(form)[2]);
+  EXPECT_EQ(form,ndref(form,malloc(ndnbytes(form)),nd_heap));
+  ASSERT_EQ(reader,ndioRead(reader,form))<<ndioError(reader);
+  EXPECT_EQ(0,memcmp((char*)nddata(form)+4*ndstrides(form)[2],(char*)nddata(vol)+3*ndstrides(vol)[2],ndstrides(vol)[2]));
+  ndfree(form);
+  ndioClose(reader);
+  remove_members("J.%d.tif");
+  ndfree(vol);
+}
+
+/// Writes the planes of \a arg to F.%.tif after a short delay.
+static void* follow_writer(void *arg)
+{ nd_t vol=(nd_t)arg;
+  ndio_t file;
+  usleep(100000);
+  file=ndioOpen("F.%.tif",ndioFormat("series"),"w");
+  ndioWrite(file,vol);
+  ndioClose(file);
+  return 0;
+}
+
+TEST_F(Series,Follow)
+{ nd_t vol,plane;
+  ndio_t file=0;
+  ndio_series_params_t params;
+  pthread_t writer;
+  // Read data set A
+  { struct _files_t *cur=file_table;
+    EXPECT_NE((void*)NULL,file=ndioOpen(cur->path,ndioFormat("series"),"r"));
+    ASSERT_NE((void*)NULL, vol=ndioShape(file))<<ndioError(file)<<"\n\t"<<cur->path;
+    ASSERT_NE((void*)NULL, plane=ndioShape(file));
+    EXPECT_EQ(vol,ndref(vol,malloc(ndnbytes(vol)),nd_heap));
+    ASSERT_EQ(file,ndioRead(file,vol));
+    ndioClose(file);
+  }
+  ndShapeSet(plane,2,1);
+  EXPECT_EQ(plane,ndref(plane,malloc(ndnbytes(plane)),nd_heap));
+  remove("F.3.tif");
+  // Seek to a plane before it's written
+  ASSERT_NE((void*)NULL,file=ndioOpen("F.%.tif",ndioFormat("series"),"r"));
+  params=((ndio_series_t*)ndioGet(file))->params;
+  params.follow=1;
+  params.timeout_ms=5000;
+  ASSERT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  ASSERT_EQ(0,pthread_create(&writer,NULL,follow_writer,vol));
+  { size_t pos[]={0,0,3};
+    EXPECT_EQ(file,ndioReadSubarray(file,plane,pos,0))<<ndioError(file);
+    EXPECT_EQ(0,memcmp(nddata(plane),(char*)nddata(vol)+3*ndstrides(vol)[2],ndnbytes(plane)));
+  }
+  pthread_join(writer,NULL);
+  // A plane that never shows up times out
+  params.timeout_ms=50;
+  ASSERT_EQ(file,ndioSet(file,&params,sizeof(params)));
+  { size_t pos[]={0,0,100};
+    EXPECT_EQ(NULL,ndioReadSubarray(file,plane,pos,0));
+  }
+  ndioClose(file);
+  ndfree(plane);
+  ndfree(vol);
+}
+#endif
 /// @endcond
@@ -0,0 +1,58 @@
+/** \file
+    Testing the type conversions and statistics done while copying members.
+    @cond TEST
+*/
+
+// solves a std::tuple problem in vs2012
+#define GTEST_HAS_TR1_TUPLE     0
+#define GTEST_USE_OWN_TR1_TUPLE 1
+
+#include <gtest/gtest.h>
+#include <limits>
+#include "src/xfer.h"
+
+TEST(Xfer,StatsSkipNaN)
+{ const float nan=std::numeric_limits<float>::quiet_NaN();
+  float v[]={nan,1.0f,nan,3.0f,0.5f,nan,2.0f,nan,nan};
+  size_t hist[4],shape[]={9},strides[]={sizeof(float)},sparse[]={2*sizeof(float)},half[]={5};
+  xfer_stats_t st;
+  // contiguous
+  xfer_stats_init(&st,0,4,4,hist);
+  ASSERT_TRUE(xfer_stats(v,strides,nd_f32,1,shape,&st));
+  EXPECT_EQ(4u,st.n);
+  EXPECT_EQ(0.5,st.min);
+  EXPECT_EQ(3.0,st.max);
+  EXPECT_EQ(6.5,st.sum);
+  EXPECT_EQ(1u,hist[0]);
+  EXPECT_EQ(1u,hist[1]);
+  EXPECT_EQ(1u,hist[2]);
+  EXPECT_EQ(1u,hist[3]);
+  // strided: every other value, so 0.5 and 2 among the NaNs
+  xfer_stats_init(&st,0,4,4,hist);
+  ASSERT_TRUE(xfer_stats(v,sparse,nd_f32,1,half,&st));
+  EXPECT_EQ(2u,st.n);
+  EXPECT_EQ(0.5,st.min);
+  EXPECT_EQ(2.0,st.max);
+  EXPECT_EQ(1u,hist[0]);
+  EXPECT_EQ(1u,hist[2]);
+  // only a NaN
+  shape[0]=1;
+  xfer_stats_init(&st,0,4,4,hist);
+  ASSERT_TRUE(xfer_stats(v,strides,nd_f32,1,shape,&st));
+  EXPECT_EQ(0u,st.n);
+  EXPECT_EQ(0u,hist[0]+hist[1]+hist[2]+hist[3]);
+}
+
+TEST(Xfer,NaNToInteger)
+{ const double nan=std::numeric_limits<double>::quiet_NaN();
+  double src[]={nan,1.0,nan,300.0};
+  unsigned char dst[4]={9,9,9,9};
+  size_t shape[]={4},ss[]={sizeof(double)},ds[]={1};
+  xfer_op_t op={1.0,0.0,0.0,0.0,0};
+  ASSERT_TRUE(xfer(dst,ds,nd_u8,src,ss,nd_f64,1,shape,&op));
+  EXPECT_EQ(0,dst[0]);
+  EXPECT_EQ(1,dst[1]);
+  EXPECT_EQ(0,dst[2]);
+  EXPECT_EQ(255,dst[3]);
+}
+/// @endcond